@@ -1,7 +1,101 @@
+#include <iostream>
+
 #include "src/parser.h"
+#include "src/interpreter.h"
+#include "src/server.h"
+#include "src/language_server.h"
+
+// sorth serve [socket]                        -- run the compile server
+// sorth <check|compile> <file> [--socket path] -- ask the server, or work locally if none is running
+// sorth lsp                                   -- language server on stdio
+// sorth [file] [--tier-report] [--perf-map] [--profile-generate|--profile-use profile] [--lex-threads n]
+//                                             -- run main of the file
+static int run_client(sorth::server::RequestType type, int argc, char** argv) {
+    std::filesystem::path path;
+    auto socket_path = sorth::server::default_socket_path();
+    for (int i = 2; i < argc; ++i) {
+        std::string_view arg{argv[i]};
+        if (arg == "--socket" && i + 1 < argc) socket_path = argv[++i];
+        else path = arg;
+    }
+    auto response = sorth::server::send_request(socket_path, type, path);
+    if (!response) response = sorth::server::handle_locally(type, path);
+    (response->ok ? std::cout : std::cerr) << response->message << std::endl;
+    return response->ok ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        std::string_view command{argv[1]};
+        if (command == "serve") {
+            sorth::server::CompileServer server{argc > 2 ? argv[2] : sorth::server::default_socket_path()};
+            server.serve();
+            return 0;
+        }
+        if (command == "lsp") {
+            sorth::lsp::LanguageServer server{std::cin, std::cout};
+            return server.run();
+        }
+        if (command == "check") return run_client(sorth::server::request_check, argc, argv);
+        if (command == "compile") return run_client(sorth::server::request_compile, argc, argv);
+        if (command == "shutdown") {
+            auto response = sorth::server::send_request(argc > 2 ? argv[2] : sorth::server::default_socket_path(), sorth::server::request_shutdown, {});
+            return response ? 0 : 1;
+        }
+    }
 
-int main() {
     std::filesystem::path path{R"(C:\Users\Simon\CLionProjects\sorth\test.sorth)"};
-    const auto program = sorth::parse_program(path);
+    bool tier_report = false;
+    bool perf_map = false;
+    std::optional<std::filesystem::path> profile_generate;
+    std::optional<std::filesystem::path> profile_use;
+    size_t lex_threads = 1;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg{argv[i]};
+        if (arg == "--tier-report") tier_report = true;
+        else if (arg == "--perf-map") perf_map = true;
+        else if (arg == "--profile-generate" && i + 1 < argc) profile_generate = argv[++i];
+        else if (arg == "--profile-use" && i + 1 < argc) profile_use = argv[++i];
+        else if (arg == "--lex-threads" && i + 1 < argc) lex_threads = std::stoul(argv[++i]);
+        else path = arg;
+    }
+    try {
+        const auto program = lex_threads > 1 ? sorth::parse_program_parallel(path, lex_threads) : sorth::parse_program(path);
+        if (!program.functions.contains("main")) return 0;
+        const auto& signature = program.functions.at("main").signature;
+        if (!signature.in.empty()) {
+            std::cerr << "main must not take any inputs, got: " << sorth::type::output_signature(signature) << std::endl;
+            return 1;
+        }
+        sorth::runtime::Scheduler scheduler;
+        sorth::runtime::StackPool stack_pool;
+        sorth::runtime::Arena arena;
+        std::unique_ptr<sorth::runtime::PerfMap> symbols;
+        if (perf_map) symbols = std::make_unique<sorth::runtime::PerfMap>();
+        std::optional<sorth::profile::Profile> profile;
+        if (profile_use) profile = sorth::profile::load(*profile_use);
+        sorth::runtime::InterpreterOptions options;
+        options.perf_map = symbols.get();
+        options.instrument = profile_generate.has_value();
+        options.profile = profile ? &*profile : nullptr;
+        sorth::runtime::Interpreter interpreter{program, scheduler, stack_pool, arena, options};
+        sorth::runtime::DataStack stack;
+        interpreter.call("main", stack);
+        for (const auto& value : stack) {
+            std::cout << value << ' ';
+        }
+        std::cout << std::endl;
+        if (tier_report) interpreter.report(std::cerr);
+        if (profile_generate) sorth::profile::save(interpreter.profile(), *profile_generate);
+    } catch (const sorth::ParseException& ex) {
+        std::cerr << ex.what();
+        return 1;
+    } catch (const sorth::runtime::RuntimeException& ex) {
+        std::cerr << "Runtime error: " << ex.what() << std::endl;
+        return 1;
+    } catch (const sorth::profile::ProfileException& ex) {
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
     return 0;
 }
@@ -0,0 +1,356 @@
+#include <algorithm>
+#include <sstream>
+
+#include "analysis.h"
+#include "parser.h"
+
+namespace sorth::analysis {
+
+    static bool is_white_space(char c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    void Document::index_lines() {
+        m_line_offsets = {0};
+        for (size_t position = m_text.find('\n'); position != std::string::npos; position = m_text.find('\n', position + 1)) {
+            m_line_offsets.push_back(position + 1);
+        }
+    }
+
+    size_t Document::offset_of(const Lexer::Location& location) const {
+        if (location.line < 1) return 0;
+        if (location.line > static_cast<int64_t>(m_line_offsets.size())) return m_text.size();
+        const auto line_begin = m_line_offsets[location.line - 1];
+        const auto line_end = std::min(m_text.find('\n', line_begin), m_text.size());
+        return std::min(line_begin + static_cast<size_t>(std::max<int64_t>(location.column - 1, 0)), line_end);
+    }
+
+    std::vector<Document::Span> Document::split(size_t begin, Lexer::Location start, const std::function<bool(size_t)>& resync) const {
+        // words are delimited like the lexer does it, cuts are only ever made at depth 0
+        std::vector<Span> spans;
+        int64_t depth = 0;
+        int64_t line = start.line;
+        size_t line_start = begin - static_cast<size_t>(start.column);
+        size_t position = begin;
+        bool resynced = false;
+        spans.push_back({begin, 0, start});
+        while (!resynced && position < m_text.size()) {
+            const char c = m_text[position];
+            if (is_white_space(c)) {
+                if (c == '\n') {
+                    ++line;
+                    line_start = position + 1;
+                }
+                ++position;
+                continue;
+            }
+            const auto word_begin = position;
+            if (c == '"') {
+                ++position;
+                while (position < m_text.size() && m_text[position] != '"' && m_text[position] != '\n') ++position;
+                if (position < m_text.size() && m_text[position] == '"') ++position;
+            } else {
+                while (position < m_text.size() && !is_white_space(m_text[position])) ++position;
+            }
+            const std::string_view word{m_text.data() + word_begin, position - word_begin};
+            if (word == "{") {
+                ++depth;
+            } else if (word == "}") {
+                depth = std::max<int64_t>(depth - 1, 0);
+            } else if (word == "func" && depth == 0 && word_begin != begin) {
+                spans.back().end = word_begin;
+                resynced = resync && resync(word_begin);
+                if (!resynced) spans.push_back({word_begin, 0, {line, static_cast<int64_t>(word_begin - line_start)}});
+            }
+        }
+        if (!resynced) spans.back().end = m_text.size();
+        // text in front of the first function only matters if there is something in it
+        const auto& prefix = spans.front();
+        if (std::all_of(m_text.begin() + static_cast<int64_t>(prefix.begin), m_text.begin() + static_cast<int64_t>(prefix.end), is_white_space)) {
+            spans.erase(spans.begin());
+        }
+        return spans;
+    }
+
+    std::unique_ptr<Document::Chunk> Document::make_chunk(std::string text, int64_t start_column) const {
+        auto chunk = std::make_unique<Chunk>();
+        chunk->text = std::move(text);
+        chunk->start_column = start_column;
+        const Lexer::Location start{1, start_column};
+        for (Lexer lexer{m_path, chunk->text, start}; lexer.current_token().type != Lexer::tok_eof; lexer.next_token()) {
+            if (lexer.current_token().type == Lexer::tok_word) chunk->words.push_back(lexer.current_token().str_val);
+        }
+        std::sort(chunk->words.begin(), chunk->words.end());
+        chunk->words.erase(std::unique(chunk->words.begin(), chunk->words.end()), chunk->words.end());
+
+        Lexer lexer{m_path, chunk->text, start};
+        const auto& token = lexer.current_token();
+        if (token.type != Lexer::tok_keyword || token.int_val != lang::keyword_function) {
+            chunk->diagnostics.push_back({token.location, 0, "Unexpected token"});
+            chunk->checked = true;
+            return chunk;
+        }
+        try {
+            chunk->header = parse_function_signature(lexer, {});
+        } catch (const ParseException& ex) {
+            chunk->diagnostics.push_back({ex.location, 0, ex.reason});
+            chunk->checked = true;
+        }
+        if (chunk->header) {
+            auto& own = chunk->words;
+            own.erase(std::remove(own.begin(), own.end(), chunk->header->name), own.end());
+        }
+        return chunk;
+    }
+
+    void Document::add_to_graph(Chunk& chunk) {
+        if (!chunk.header) return;
+        m_definitions[chunk.header->name].push_back(&chunk);
+        for (const auto& word : chunk.words) {
+            m_dependents[word].push_back(&chunk);
+        }
+    }
+
+    void Document::remove_from_graph(Chunk& chunk) {
+        if (!chunk.header) return;
+        auto remove = [&chunk](std::unordered_map<std::string, std::vector<Chunk*>>& graph, const std::string& name) {
+            auto it = graph.find(name);
+            std::erase(it->second, &chunk);
+            if (it->second.empty()) graph.erase(it);
+        };
+        remove(m_definitions, chunk.header->name);
+        for (const auto& word : chunk.words) {
+            remove(m_dependents, word);
+        }
+    }
+
+    const type::TypeSignature* Document::visible_signature(const std::string& name, size_t index) const {
+        // functions can only call the ones defined before them
+        auto it = m_functions.find(name);
+        if (it == m_functions.end() || it->second->index >= index) return nullptr;
+        return &it->second->header->signature;
+    }
+
+    bool Document::check_if_outdated(Chunk& chunk) {
+        bool outdated = !chunk.checked;
+        for (size_t i = 0; !outdated && i < chunk.words.size(); ++i) {
+            const auto signature = visible_signature(chunk.words[i], chunk.index);
+            const auto& seen = chunk.view[i];
+            outdated = (signature != nullptr) != seen.has_value() || (seen && (seen->in != signature->in || seen->out != signature->out));
+        }
+        if (!outdated) return false;
+        std::vector<std::optional<type::TypeSignature>> view;
+        for (const auto& word : chunk.words) {
+            const auto signature = visible_signature(word, chunk.index);
+            view.push_back(signature ? std::optional{*signature} : std::nullopt);
+        }
+        check(chunk, std::move(view));
+        return true;
+    }
+
+    void Document::check(Chunk& chunk, std::vector<std::optional<type::TypeSignature>> view) const {
+        ast::Program program;
+        for (size_t i = 0; i < chunk.words.size(); ++i) {
+            if (view[i]) program.functions[chunk.words[i]] = {chunk.words[i], *view[i], {}};
+        }
+        chunk.diagnostics.clear();
+        Lexer lexer{m_path, chunk.text, {1, chunk.start_column}};
+        try {
+            parse_function(lexer, program);
+            lexer.next_token();
+            if (lexer.current_token().type != Lexer::tok_eof)
+                chunk.diagnostics.push_back({lexer.current_token().location, 0, "Unexpected token"});
+        } catch (const ParseException& ex) {
+            chunk.diagnostics.push_back({ex.location, 0, ex.reason});
+        }
+        chunk.view = std::move(view);
+        chunk.checked = true;
+    }
+
+    int64_t Document::update(std::string text) {
+        m_text = std::move(text);
+        index_lines();
+        return replace(0, m_chunks.size(), split(0, {1, 0}), 0, 0);
+    }
+
+    int64_t Document::edit(const Lexer::Location& start, const Lexer::Location& end, std::string_view text) {
+        const auto begin = offset_of(start);
+        const auto removed_end = std::max(begin, offset_of(end));
+        const auto removed = std::string_view{m_text}.substr(begin, removed_end - begin);
+        const auto line_delta = std::count(text.begin(), text.end(), '\n') - std::count(removed.begin(), removed.end(), '\n');
+        const auto offset_delta = static_cast<int64_t>(text.size()) - static_cast<int64_t>(removed.size());
+        m_text.replace(begin, removed.size(), text);
+
+        // the line index moves along with the text after the edit
+        const auto first_line = std::upper_bound(m_line_offsets.begin(), m_line_offsets.end(), begin);
+        const auto last_line = std::upper_bound(first_line, m_line_offsets.end(), removed_end);
+        for (auto it = last_line; it != m_line_offsets.end(); ++it) {
+            *it += offset_delta;
+        }
+        std::vector<size_t> inserted_lines;
+        for (size_t i = 0; i < text.size(); ++i) {
+            if (text[i] == '\n') inserted_lines.push_back(begin + i + 1);
+        }
+        m_line_offsets.insert(m_line_offsets.erase(first_line, last_line), inserted_lines.begin(), inserted_lines.end());
+
+        // The cut in front of the edit stays where it is, unless the edit touches the func it was made
+        // at. Cutting again from there, everything is cut as before once a cut lands on an old one
+        // behind the edit at depth 0. Chunks starting on the line the edit ends on would change their
+        // column, so the earliest cut is a line later
+        static constexpr size_t func_size = std::string_view{"func"}.size();
+        const auto first = static_cast<size_t>(std::partition_point(m_chunks.begin(), m_chunks.end(), [begin](const auto& chunk) { return chunk->begin + func_size < begin; }) - m_chunks.begin());
+        const auto split_chunk = first > 0 ? first - 1 : 0;
+        const auto split_begin = first > 0 ? m_chunks[split_chunk]->begin : 0;
+        const auto split_start = first > 0 ? m_chunks[split_chunk]->start : Lexer::Location{1, 0};
+        const auto end_of_edit_line = m_text.find('\n', begin + text.size());
+        const auto earliest_resync = end_of_edit_line == std::string::npos ? m_text.size() : end_of_edit_line + 1;
+        auto next_old = static_cast<size_t>(std::partition_point(m_chunks.begin(), m_chunks.end(), [removed_end](const auto& chunk) { return chunk->begin < removed_end; }) - m_chunks.begin());
+        bool resynced = false;
+        const auto spans = split(split_begin, split_start, [&](size_t position) {
+            if (position < earliest_resync) return false;
+            while (next_old < m_chunks.size() && static_cast<int64_t>(m_chunks[next_old]->begin) + offset_delta < static_cast<int64_t>(position)) ++next_old;
+            resynced = next_old < m_chunks.size() && static_cast<int64_t>(m_chunks[next_old]->begin) + offset_delta == static_cast<int64_t>(position);
+            return resynced;
+        });
+        return replace(split_chunk, resynced ? next_old : m_chunks.size(), spans, offset_delta, line_delta);
+    }
+
+    int64_t Document::replace(size_t first, size_t last, const std::vector<Span>& spans, int64_t offset_delta, int64_t line_delta) {
+        // reuse chunks whose text didn't change, even if they moved to another line. An edit usually
+        // touches a single region, so the unchanged prefix and suffix are matched up front
+        auto text_of = [this](const Span& span) {
+            return std::string_view{m_text.data() + span.begin, span.end - span.begin};
+        };
+        auto matches = [&](const std::unique_ptr<Chunk>& chunk, const Span& span) {
+            return chunk && chunk->start_column == span.start.column && chunk->text == text_of(span);
+        };
+        std::vector<std::unique_ptr<Chunk>> previous;
+        previous.reserve(last - first);
+        std::move(m_chunks.begin() + static_cast<int64_t>(first), m_chunks.begin() + static_cast<int64_t>(last), std::back_inserter(previous));
+        const auto replaced = m_chunks.erase(m_chunks.begin() + static_cast<int64_t>(first), m_chunks.begin() + static_cast<int64_t>(last));
+        std::vector<std::unique_ptr<Chunk>> placeholders(spans.size());
+        m_chunks.insert(replaced, std::make_move_iterator(placeholders.begin()), std::make_move_iterator(placeholders.end()));
+        // chunks behind the region only move, and get a new index if the number of chunks changed
+        const auto index_delta = spans.size() != last - first;
+        if (offset_delta != 0 || line_delta != 0 || index_delta) {
+            for (size_t i = first + spans.size(); i < m_chunks.size(); ++i) {
+                auto& chunk = *m_chunks[i];
+                chunk.begin = static_cast<size_t>(static_cast<int64_t>(chunk.begin) + offset_delta);
+                chunk.start.line += line_delta;
+                chunk.index = i;
+            }
+        }
+        size_t prefix = 0;
+        while (prefix < spans.size() && prefix < previous.size() && matches(previous[prefix], spans[prefix])) {
+            m_chunks[first + prefix] = std::move(previous[prefix]);
+            ++prefix;
+        }
+        size_t suffix = 0;
+        while (suffix < spans.size() - prefix && suffix < previous.size() - prefix
+               && matches(previous[previous.size() - 1 - suffix], spans[spans.size() - 1 - suffix])) {
+            m_chunks[first + spans.size() - 1 - suffix] = std::move(previous[previous.size() - 1 - suffix]);
+            ++suffix;
+        }
+
+        // every function defined in the edited region may now resolve to another definition
+        std::vector<std::string> changed_names;
+        std::unordered_multimap<std::string_view, std::unique_ptr<Chunk>> moved;
+        for (size_t i = prefix; i < previous.size() - suffix; ++i) {
+            if (previous[i]->header) changed_names.push_back(previous[i]->header->name);
+            std::string_view key{previous[i]->text};
+            moved.emplace(key, std::move(previous[i]));
+        }
+        for (size_t i = prefix; i < spans.size() - suffix; ++i) {
+            auto& chunk = m_chunks[first + i];
+            auto [same_first, same_last] = moved.equal_range(text_of(spans[i]));
+            auto it = std::find_if(same_first, same_last, [&](const auto& entry) { return matches(entry.second, spans[i]); });
+            if (it != same_last) {
+                chunk = std::move(it->second);
+                moved.erase(it);
+            } else {
+                chunk = make_chunk(std::string{text_of(spans[i])}, spans[i].start.column);
+                add_to_graph(*chunk);
+            }
+            if (chunk->header) changed_names.push_back(chunk->header->name);
+        }
+        for (auto& [key, chunk] : moved) {
+            if (chunk->header) {
+                if (auto it = m_functions.find(chunk->header->name); it != m_functions.end() && it->second == chunk.get()) m_functions.erase(it);
+            }
+            remove_from_graph(*chunk);
+        }
+        moved.clear();
+        for (size_t i = 0; i < spans.size(); ++i) {
+            m_chunks[first + i]->begin = spans[i].begin;
+            m_chunks[first + i]->start = spans[i].start;
+            m_chunks[first + i]->index = first + i;
+        }
+
+        std::sort(changed_names.begin(), changed_names.end());
+        changed_names.erase(std::unique(changed_names.begin(), changed_names.end()), changed_names.end());
+        std::vector<Chunk*> outdated;
+        for (size_t i = prefix; i < spans.size() - suffix; ++i) {
+            outdated.push_back(m_chunks[first + i].get());
+        }
+        for (const auto& name : changed_names) {
+            if (auto it = m_definitions.find(name); it != m_definitions.end()) {
+                auto first = *std::min_element(it->second.begin(), it->second.end(), [](const Chunk* a, const Chunk* b) { return a->index < b->index; });
+                m_functions[name] = first;
+                for (auto chunk : it->second) {
+                    chunk->redefinition = chunk != first;
+                }
+            } else {
+                m_functions.erase(name);
+            }
+            if (auto it = m_dependents.find(name); it != m_dependents.end()) {
+                outdated.insert(outdated.end(), it->second.begin(), it->second.end());
+            }
+        }
+        std::sort(outdated.begin(), outdated.end());
+        outdated.erase(std::unique(outdated.begin(), outdated.end()), outdated.end());
+
+        int64_t checked = 0;
+        for (auto chunk : outdated) {
+            if (chunk->header && check_if_outdated(*chunk)) ++checked;
+        }
+
+        m_diagnostics.clear();
+        for (const auto& chunk : m_chunks) {
+            for (auto diagnostic : chunk->diagnostics) {
+                diagnostic.location.line += chunk->start.line - 1;
+                m_diagnostics.push_back(diagnostic);
+            }
+            if (chunk->redefinition) {
+                auto location = chunk->header->location;
+                location.line += chunk->start.line - 1;
+                m_diagnostics.push_back({location, 0, "Redefinition of function: " + chunk->header->name});
+            }
+        }
+        for (auto& diagnostic : m_diagnostics) {
+            diagnostic.length = std::max<int64_t>(static_cast<int64_t>(word_at(diagnostic.location).size()), 1);
+        }
+        return checked;
+    }
+
+    std::string_view Document::word_at(const Lexer::Location& location) const {
+        if (location.line < 1 || location.line > static_cast<int64_t>(m_line_offsets.size())) return {};
+        const auto line_begin = m_line_offsets[location.line - 1];
+        const auto line_end = std::min(m_text.find('\n', line_begin), m_text.size());
+        auto position = line_begin + std::max<int64_t>(location.column - 1, 0);
+        if (position >= line_end || is_white_space(m_text[position])) return {};
+        auto begin = position;
+        while (begin > line_begin && !is_white_space(m_text[begin - 1])) --begin;
+        auto end = position;
+        while (end < line_end && !is_white_space(m_text[end])) ++end;
+        return {m_text.data() + begin, end - begin};
+    }
+
+    std::optional<std::string> Document::hover(const Lexer::Location& location) const {
+        const auto word = word_at(location);
+        auto it = m_functions.find(std::string{word});
+        if (it == m_functions.end()) return std::nullopt;
+        std::stringstream out;
+        out << "func " << it->first << ' ' << type::output_signature(it->second->header->signature);
+        return out.str();
+    }
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <filesystem>
+#include <functional>
+#include <string_view>
+#include <limits>
+#include <unordered_map>
+
+#include "ast.h"
+#include "lexer.h"
+#include "type.h"
+
+namespace sorth::analysis {
+
+    struct Diagnostic {
+        Lexer::Location location;
+        int64_t length;
+        std::string message;
+    };
+
+    // Incrementally re-checks a source file. The text is cut into one chunk per function, and every
+    // chunk remembers the signatures it saw for the words it references when it was last checked.
+    // After an edit only changed chunks and chunks whose view of a signature changed get parsed again.
+    class Document {
+
+    public:
+
+        explicit Document(std::filesystem::path path) : m_path(std::move(path)) {}
+
+        // Replaces the text, returns the number of functions that had to be checked again
+        int64_t update(std::string text);
+
+        // Replaces the text between two 1-based locations, the end is exclusive. Only the functions
+        // around the edit are cut out of the text again. Returns the same as update
+        int64_t edit(const Lexer::Location& start, const Lexer::Location& end, std::string_view text);
+
+        const std::vector<Diagnostic>& diagnostics() const { return m_diagnostics; }
+
+        // Signature of the function named at the 1-based location, if there is one
+        std::optional<std::string> hover(const Lexer::Location& location) const;
+
+    private:
+        struct Chunk {
+            std::string text;
+            int64_t start_column;
+            // name and signature, if the header could be parsed
+            std::optional<ast::Function> header;
+            // every word of the chunk, which is every function it may depend on
+            std::vector<std::string> words;
+            // signatures of the words at the last check, nothing if the word was unknown
+            std::vector<std::optional<type::TypeSignature>> view;
+            bool checked{false};
+            // relative to the first line of the chunk
+            std::vector<Diagnostic> diagnostics;
+            // position in the text as of the last update
+            size_t index{std::numeric_limits<size_t>::max()};
+            size_t begin{0};
+            Lexer::Location start{1, 0};
+            // an earlier chunk defines a function with the same name
+            bool redefinition{false};
+        };
+
+        struct Span {
+            size_t begin;
+            size_t end;
+            Lexer::Location start;
+        };
+
+        std::filesystem::path m_path;
+        std::string m_text;
+        std::vector<size_t> m_line_offsets;
+        // in order of the text
+        std::vector<std::unique_ptr<Chunk>> m_chunks;
+        // dependency graph: the chunks defining and the chunks referencing every name
+        std::unordered_map<std::string, std::vector<Chunk*>> m_definitions;
+        std::unordered_map<std::string, std::vector<Chunk*>> m_dependents;
+        // first definition of every function
+        std::unordered_map<std::string, Chunk*> m_functions;
+        std::vector<Diagnostic> m_diagnostics;
+
+        void index_lines();
+
+        // offset in the text of the 1-based location, clamped to the end of its line
+        size_t offset_of(const Lexer::Location& location) const;
+
+        // Cuts the text at every func at the top level, starting at a cut at the given offset. It stops
+        // at the first later cut resync accepts, if given, after which the text is cut as before
+        std::vector<Span> split(size_t begin, Lexer::Location start, const std::function<bool(size_t)>& resync = {}) const;
+
+        // Replaces the chunks [first, last) with chunks for the spans, the chunks after them moved
+        // by offset_delta bytes and line_delta lines
+        int64_t replace(size_t first, size_t last, const std::vector<Span>& spans, int64_t offset_delta, int64_t line_delta);
+
+        std::unique_ptr<Chunk> make_chunk(std::string text, int64_t start_column) const;
+
+        void add_to_graph(Chunk& chunk);
+
+        void remove_from_graph(Chunk& chunk);
+
+        // signature of the function as seen from the chunk at the given index
+        const type::TypeSignature* visible_signature(const std::string& name, size_t index) const;
+
+        // checks the chunk again, if it's new or the signatures it depends on changed
+        bool check_if_outdated(Chunk& chunk);
+
+        void check(Chunk& chunk, std::vector<std::optional<type::TypeSignature>> view) const;
+
+        std::string_view word_at(const Lexer::Location& location) const;
+    };
+}
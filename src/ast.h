@@ -11,6 +11,7 @@
 
 #include "type.h"
 #include "lang.h"
+#include "lexer.h"
 
 namespace sorth::ast {
 
@@ -26,7 +27,11 @@ namespace sorth::ast {
 
     // Base class for all expressions
     struct Expression {
-        virtual ExpressionType get_type() { return expr_none; };
+        // source location of the token the expression was parsed from
+        Lexer::Location location{1, 0};
+
+        virtual ~Expression() = default;
+        virtual ExpressionType get_type() const { return expr_none; };
     };
 
     struct OperationExpression : Expression {
@@ -35,7 +40,7 @@ namespace sorth::ast {
 
         explicit OperationExpression(lang::Operation operation) : operation(operation) {}
 
-        ExpressionType get_type() override {
+        ExpressionType get_type() const override {
             return expr_operation;
         };
     };
@@ -47,7 +52,7 @@ namespace sorth::ast {
 
         ValueType value;
 
-        ExpressionType get_type() override {
+        ExpressionType get_type() const override {
             if constexpr (std::is_same_v<ValueType, std::string>) {
                 return expr_operation_string;
             }
@@ -78,7 +83,7 @@ namespace sorth::ast {
         type::TypeSignature signature{};
         std::vector<std::unique_ptr<Expression>> expressions;
 
-        ExpressionType get_type() override { return expr_scope; };
+        ExpressionType get_type() const override { return expr_scope; };
     };
 
     struct ConditionalBranch {
@@ -99,7 +104,7 @@ namespace sorth::ast {
         std::vector<ConditionalBranch> else_if;
         Scope else_body;
 
-        ExpressionType get_type() override { return expr_if; };
+        ExpressionType get_type() const override { return expr_if; };
     };
 
     struct WhileExpression : Expression {
@@ -114,16 +119,27 @@ namespace sorth::ast {
         Scope condition;
         Scope body;
 
-        ExpressionType get_type() override { return expr_while; };
+        ExpressionType get_type() const override { return expr_while; };
     };
 
     struct Function {
         std::string name;
         type::TypeSignature signature;
         Scope body;
+        Lexer::Location location{1, 0};
+    };
+
+    struct StringLiteral {
+        int64_t offset;
+        int64_t size;
     };
 
     struct Program {
+        std::filesystem::path path;
         std::unordered_map<std::string, Function> functions;
+        // read-only data segment, every distinct string literal is stored once
+        std::string data;
+        std::vector<StringLiteral> strings;
+        std::unordered_map<std::string, int64_t> string_ids;
     };
 }
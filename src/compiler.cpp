@@ -0,0 +1,174 @@
+#include <numeric>
+#include <algorithm>
+
+#include "compiler.h"
+
+namespace sorth::compiler {
+
+    struct ColdBlock {
+        const ast::Scope* body;
+        std::vector<const ast::Function*> functions;
+        int64_t jump;
+        int64_t resume;
+    };
+
+    struct Context {
+        const ast::Program& program;
+        const FunctionResolver& resolve;
+        const CompileOptions& options;
+        Code code;
+        // function whose body is being compiled, the ones further up are inlined into it
+        std::vector<const ast::Function*> functions;
+        // rarely taken branches, placed behind the body of the function
+        std::vector<ColdBlock> cold_blocks;
+    };
+
+    static void compile(const ast::Scope& scope, Context& context);
+
+    static int64_t emit(Context& context, lang::Operation operation, int64_t operand = 0) {
+        context.code.instructions.push_back({operation, operand});
+        return static_cast<int64_t>(context.code.instructions.size()) - 1;
+    }
+
+    static int64_t position(const Context& context) {
+        return static_cast<int64_t>(context.code.instructions.size());
+    }
+
+    static void patch_jump(Context& context, int64_t jump, int64_t target) {
+        context.code.instructions[jump].operand = target;
+    }
+
+    static int64_t expression_count(const ast::Scope& scope) {
+        int64_t count = 0;
+        for (const auto& expression : scope.expressions) {
+            switch (expression->get_type()) {
+                case ast::expr_scope:
+                    count += expression_count(static_cast<const ast::Scope&>(*expression));
+                    break;
+                case ast::expr_if:
+                {
+                    const auto& if_expr = static_cast<const ast::IfExpression&>(*expression);
+                    count += expression_count(if_expr.first_if.condition) + expression_count(if_expr.first_if.body) + expression_count(if_expr.else_body);
+                    for (const auto& branch : if_expr.else_if) {
+                        count += expression_count(branch.condition) + expression_count(branch.body);
+                    }
+                }
+                    break;
+                default:
+                    ++count;
+                    break;
+            }
+        }
+        return count;
+    }
+
+    static const ast::Function* inline_candidate(const ast::OperationExpression& operation, const std::string& name, Context& context) {
+        const auto profile = context.options.profile;
+        if (!profile || operation.operation != lang::op_call) return nullptr;
+        if (static_cast<int64_t>(context.functions.size()) > context.options.max_inline_depth) return nullptr;
+        if (profile->call_site_count(context.functions.back()->name, operation.location) < context.options.inline_threshold) return nullptr;
+        const auto& callee = context.program.functions.at(name);
+        // recursive calls can't be inlined
+        if (std::find(context.functions.begin(), context.functions.end(), &callee) != context.functions.end()) return nullptr;
+        if (expression_count(callee.body) > context.options.max_inline_size) return nullptr;
+        return &callee;
+    }
+
+    static void compile(const ast::OperationExpression& operation, Context& context) {
+        switch (operation.get_type()) {
+            case ast::expr_operation_int:
+                emit(context, operation.operation, static_cast<const ast::IntOperationExpression&>(operation).value);
+                break;
+            case ast::expr_operation_string:
+            {
+                const auto& name = static_cast<const ast::StringOperationExpression&>(operation).value;
+                if (const auto callee = inline_candidate(operation, name, context)) {
+                    context.functions.push_back(callee);
+                    compile(callee->body, context);
+                    context.functions.pop_back();
+                    break;
+                }
+                emit(context, operation.operation, operation.operation == lang::op_join ? 0 : context.resolve(name));
+            }
+                break;
+            default:
+                emit(context, operation.operation);
+                break;
+        }
+    }
+
+    static void compile(const ast::IfExpression& if_expr, Context& context) {
+        auto counts = context.options.profile ? context.options.profile->branch_counts(context.functions.back()->name, if_expr.location) : nullptr;
+        const auto branch_count = static_cast<int64_t>(if_expr.else_if.size()) + 2;
+        if (counts && static_cast<int64_t>(counts->size()) != branch_count) counts = nullptr;
+
+        std::vector<int64_t> jumps_to_end;
+        std::vector<ColdBlock> cold_blocks;
+        auto compile_branch = [&](const ast::ConditionalBranch& branch, int64_t index) {
+            compile(branch.condition, context);
+            // a body taken less often than the branches after it is moved out of line,
+            // so the hot path falls through without jumping
+            if (counts && counts->at(index) < std::accumulate(counts->begin() + index + 1, counts->end(), int64_t{0})) {
+                cold_blocks.push_back({&branch.body, context.functions, emit(context, lang::op_jump_if), 0});
+                return;
+            }
+            auto skip_body = emit(context, lang::op_jump_unless);
+            compile(branch.body, context);
+            jumps_to_end.push_back(emit(context, lang::op_jump));
+            patch_jump(context, skip_body, position(context));
+        };
+        compile_branch(if_expr.first_if, 0);
+        for (int64_t i = 0; i < static_cast<int64_t>(if_expr.else_if.size()); ++i) {
+            compile_branch(if_expr.else_if[i], i + 1);
+        }
+        compile(if_expr.else_body, context);
+        for (auto jump : jumps_to_end) {
+            patch_jump(context, jump, position(context));
+        }
+        for (auto& block : cold_blocks) {
+            block.resume = position(context);
+            context.cold_blocks.push_back(std::move(block));
+        }
+    }
+
+    static void compile(const ast::Scope& scope, Context& context) {
+        for (const auto& expression : scope.expressions) {
+            switch (expression->get_type()) {
+                case ast::expr_operation:
+                case ast::expr_operation_string:
+                case ast::expr_operation_int:
+                    compile(static_cast<const ast::OperationExpression&>(*expression), context);
+                    break;
+                case ast::expr_scope:
+                    compile(static_cast<const ast::Scope&>(*expression), context);
+                    break;
+                case ast::expr_if:
+                    compile(static_cast<const ast::IfExpression&>(*expression), context);
+                    break;
+                case ast::expr_while:
+                    throw CompileException{"While not supported yet."};
+                case ast::expr_none:
+                    break;
+            }
+        }
+    }
+
+    Code compile(const ast::Program& program, const ast::Function& function, const FunctionResolver& resolve, const CompileOptions& options) {
+        Context context{program, resolve, options, {}, {&function}, {}};
+        compile(function.body, context);
+        if (context.cold_blocks.empty()) return std::move(context.code);
+
+        const auto exit = emit(context, lang::op_jump);
+        // cold blocks can contain further cold blocks, which get appended while iterating
+        for (size_t i = 0; i < context.cold_blocks.size(); ++i) {
+            auto block = context.cold_blocks[i];
+            patch_jump(context, block.jump, position(context));
+            std::swap(context.functions, block.functions);
+            compile(*block.body, context);
+            std::swap(context.functions, block.functions);
+            patch_jump(context, emit(context, lang::op_jump), block.resume);
+        }
+        patch_jump(context, exit, position(context));
+        return std::move(context.code);
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <functional>
+
+#include "ast.h"
+#include "lang.h"
+#include "profile.h"
+
+namespace sorth::compiler {
+
+    // Flat instruction of the optimised tier. The operand holds the immediate value,
+    // the resolved function id for calls and spawns, or the target of a jump.
+    struct Instruction {
+        lang::Operation operation;
+        int64_t operand;
+    };
+
+    struct Code {
+        std::vector<Instruction> instructions;
+    };
+
+    using FunctionResolver = std::function<int64_t(const std::string&)>;
+
+    struct CompileOptions {
+        // counts of an earlier run, used to inline hot calls and lay out branches
+        const profile::Profile* profile = nullptr;
+        // calls executed at least this often get inlined
+        int64_t inline_threshold = 64;
+        // callees with more expressions than this are never inlined
+        int64_t max_inline_size = 32;
+        int64_t max_inline_depth = 4;
+    };
+
+    // Lowers the body of a function: calls get resolved, ifs become jumps
+    Code compile(const ast::Program& program, const ast::Function& function, const FunctionResolver& resolve, const CompileOptions& options = {});
+
+    struct CompileException : public std::runtime_error {
+        explicit CompileException(const std::string& message) : std::runtime_error(message) {}
+    };
+}
@@ -0,0 +1,633 @@
+#include <algorithm>
+#include <string_view>
+#include <sstream>
+
+#include "interpreter.h"
+#include "kernels.h"
+
+#if defined(__linux__)
+#include <pthread.h>
+#endif
+
+namespace sorth::runtime {
+
+    static value_t pop(DataStack& stack) {
+        auto value = stack.back();
+        stack.pop_back();
+        return value;
+    }
+
+    static std::string_view pop_string(DataStack& stack) {
+        auto size = pop(stack);
+        auto data = reinterpret_cast<const char*>(pop(stack));
+        return {data, static_cast<size_t>(size)};
+    }
+
+    static void push_string(DataStack& stack, std::string_view str) {
+        stack.push_back(reinterpret_cast<value_t>(str.data()));
+        stack.push_back(static_cast<value_t>(str.size()));
+    }
+
+    struct Buffer {
+        value_t* data;
+        int64_t size;
+    };
+
+    static Buffer pop_buffer(DataStack& stack) {
+        auto size = pop(stack);
+        auto data = reinterpret_cast<value_t*>(pop(stack));
+        return {data, size};
+    }
+
+    static void push_buffer(DataStack& stack, Buffer buffer) {
+        stack.push_back(reinterpret_cast<value_t>(buffer.data));
+        stack.push_back(buffer.size);
+    }
+
+    static void check_same_size(const Buffer& a, const Buffer& b) {
+        if (a.size != b.size) throw RuntimeException{"Buffer sizes are not matching."};
+    }
+
+    // function currently executing on this thread, used to detect back edges
+    static thread_local const FunctionState* current_function = nullptr;
+
+    // Every call nests several native frames of either tier, so deep recursion has to fail before
+    // the thread runs out of stack. Where the bounds of the stack are known, calls stop a reserve
+    // above its end, elsewhere at a depth small enough for the default stack of any build.
+#if defined(__linux__)
+    static constexpr size_t stack_reserve = 256 * 1024;
+    static thread_local const char* stack_limit = nullptr;
+
+    static bool is_stack_exhausted() {
+        if (stack_limit == nullptr) {
+            pthread_attr_t attributes;
+            void* lowest = nullptr;
+            size_t size = 0;
+            pthread_getattr_np(pthread_self(), &attributes);
+            pthread_attr_getstack(&attributes, &lowest, &size);
+            pthread_attr_destroy(&attributes);
+            stack_limit = static_cast<const char*>(lowest) + stack_reserve;
+        }
+        return static_cast<const char*>(__builtin_frame_address(0)) < stack_limit;
+    }
+#else
+    static constexpr int64_t max_call_depth = 2000;
+    static thread_local int64_t call_depth = 0;
+
+    static bool is_stack_exhausted() {
+        return call_depth >= max_call_depth;
+    }
+#endif
+
+    Interpreter::Interpreter(const ast::Program& program, Scheduler& scheduler, StackPool& stack_pool, Arena& arena, const InterpreterOptions& options)
+        : m_program(program), m_scheduler(scheduler), m_stack_pool(stack_pool), m_arena(arena), m_options(options) {
+        m_compile_options.profile = m_options.profile;
+        for (const auto& [name, function] : m_program.functions) {
+            auto id = static_cast<int64_t>(m_functions.size());
+            auto& state = m_functions.emplace_back(std::make_unique<FunctionState>());
+            state->function = &function;
+            m_function_ids.emplace(name, id);
+        }
+        if (m_options.instrument) {
+            for (const auto& [name, function] : m_program.functions) {
+                add_profile_sites(function, function.body);
+            }
+            m_counters = std::make_unique<std::atomic<int64_t>[]>(m_profile_counters.empty() ? 0 : m_profile_sites.back().first_counter + m_profile_sites.back().counter_count);
+        }
+        if (m_options.perf_map) {
+            std::vector<std::string> names;
+            for (const auto& state : m_functions) {
+                names.push_back(symbol_name(*state, "interpreted"));
+            }
+            const auto trampolines = make_trampolines(m_executable_memory, *m_options.perf_map, names);
+            for (size_t i = 0; i < trampolines.size(); ++i) {
+                m_functions[i]->interpreted_trampoline = trampolines[i];
+            }
+        }
+        if (m_options.profile && !m_options.instrument) {
+            // compile in order of hotness, so hot code ends up next to each other
+            std::vector<FunctionState*> hot;
+            std::vector<std::string> names;
+            for (const auto& name : m_options.profile->hot_functions()) {
+                if (!m_function_ids.contains(name)) continue;
+                auto& state = *m_functions[m_function_ids.at(name)];
+                state.tier = tier_compiling;
+                compile(state);
+                hot.push_back(&state);
+                names.push_back(symbol_name(state, "compiled"));
+            }
+            if (m_options.perf_map) {
+                const auto trampolines = make_trampolines(m_executable_memory, *m_options.perf_map, names);
+                for (size_t i = 0; i < trampolines.size(); ++i) {
+                    hot[i]->compiled_trampoline = trampolines[i];
+                }
+            }
+            for (auto state : hot) {
+                state->compiled.store(state->code.get(), std::memory_order_release);
+                state->tier.store(tier_compiled, std::memory_order_release);
+            }
+        }
+        m_compiler = std::thread{&Interpreter::compile_in_background, this};
+    }
+
+    Interpreter::~Interpreter() {
+        // Running tasks still spawn and join nested ones, which they own. Once none is running, the
+        // handles left over belong to nobody and only the scheduler may still touch them.
+        std::unique_lock tasks_lock{m_tasks_mutex};
+        m_tasks_finished.wait(tasks_lock, [this]() { return m_running_tasks == 0; });
+        for (auto task : m_tasks) {
+            try {
+                m_scheduler.join(*task);
+            } catch (...) {
+                // nobody is left to observe the result
+            }
+            m_stack_pool.release(std::move(task->stack));
+            delete task;
+        }
+        tasks_lock.unlock();
+        {
+            std::lock_guard lock{m_compile_mutex};
+            m_stop_compiler = true;
+        }
+        m_compile_ready.notify_one();
+        m_compiler.join();
+    }
+
+    void Interpreter::call(const std::string& name, DataStack& stack) {
+        call(*m_functions[m_function_ids.at(name)], stack);
+    }
+
+    void Interpreter::call(FunctionState& state, DataStack& stack) {
+        if (is_stack_exhausted()) throw RuntimeException{"Call stack overflow in " + state.function->name + '.'};
+        auto heat = state.calls.fetch_add(1, std::memory_order_relaxed);
+        if (current_function == &state) heat += state.back_edges.fetch_add(1, std::memory_order_relaxed);
+        else heat += state.back_edges.load(std::memory_order_relaxed);
+        const auto caller = current_function;
+        current_function = &state;
+#if !defined(__linux__)
+        ++call_depth;
+#endif
+        try {
+            const auto code = state.compiled.load(std::memory_order_acquire);
+            if (!code && heat >= m_options.promotion_threshold && !m_options.instrument) promote(state);
+            if (const auto trampoline = code ? state.compiled_trampoline : state.interpreted_trampoline) {
+                CallFrame frame{this, &state, code, &stack};
+                trampoline(&frame, &Interpreter::enter);
+                if (frame.exception) std::rethrow_exception(frame.exception);
+            } else if (code) {
+                run(*code, stack);
+            } else {
+                execute(state.function->body, stack);
+            }
+        } catch (...) {
+            current_function = caller;
+#if !defined(__linux__)
+            --call_depth;
+#endif
+            throw;
+        }
+        current_function = caller;
+#if !defined(__linux__)
+        --call_depth;
+#endif
+    }
+
+    void Interpreter::enter(void* frame) noexcept {
+        auto& call_frame = *static_cast<CallFrame*>(frame);
+        try {
+            if (call_frame.code) {
+                call_frame.interpreter->run(*call_frame.code, *call_frame.stack);
+            } else {
+                call_frame.interpreter->execute(call_frame.state->function->body, *call_frame.stack);
+            }
+        } catch (...) {
+            call_frame.exception = std::current_exception();
+        }
+    }
+
+    std::string Interpreter::symbol_name(const FunctionState& state, const char* tier) const {
+        std::stringstream name;
+        name << "sorth:" << state.function->name << " (" << m_program.path.filename().string() << ':'
+             << state.function->location.line << ") [" << tier << ']';
+        return name.str();
+    }
+
+    void Interpreter::promote(FunctionState& state) {
+        auto expected = tier_interpreted;
+        if (!state.tier.compare_exchange_strong(expected, tier_compiling)) return;
+        state.promoted_at = state.calls.load(std::memory_order_relaxed);
+        {
+            std::lock_guard lock{m_compile_mutex};
+            m_compile_queue.push_back(&state);
+        }
+        m_compile_ready.notify_one();
+    }
+
+    void Interpreter::compile(FunctionState& state) {
+        const auto resolve = [this](const std::string& name) { return m_function_ids.at(name); };
+        const auto start = std::chrono::steady_clock::now();
+        state.code = std::make_unique<compiler::Code>(compiler::compile(m_program, *state.function, resolve, m_compile_options));
+        state.compile_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    }
+
+    void Interpreter::compile_in_background() {
+        while (true) {
+            FunctionState* state;
+            {
+                std::unique_lock lock{m_compile_mutex};
+                m_compile_ready.wait(lock, [this]() { return m_stop_compiler || !m_compile_queue.empty(); });
+                if (m_stop_compiler) return;
+                state = m_compile_queue.back();
+                m_compile_queue.pop_back();
+            }
+            compile(*state);
+            if (m_options.perf_map) {
+                const auto trampolines = make_trampolines(m_executable_memory, *m_options.perf_map, {symbol_name(*state, "compiled")});
+                if (!trampolines.empty()) state->compiled_trampoline = trampolines.front();
+            }
+            state->compiled.store(state->code.get(), std::memory_order_release);
+            state->tier.store(tier_compiled, std::memory_order_release);
+        }
+    }
+
+    void Interpreter::report(std::ostream& os) const {
+        static const char* tier_names[] = {"interpreted", "compiling", "compiled"};
+        for (const auto& state : m_functions) {
+            const auto tier = state->tier.load(std::memory_order_acquire);
+            os << state->function->name << ": " << state->calls << " calls, " << state->back_edges << " back edges, " << tier_names[tier];
+            if (tier == tier_compiled) {
+                os << " after " << state->promoted_at << " calls in " << state->compile_time.count() << "us, "
+                   << state->code->instructions.size() << " instructions";
+            }
+            os << '\n';
+        }
+    }
+
+    void Interpreter::add_profile_sites(const ast::Function& function, const ast::Scope& scope) {
+        auto add_site = [&](const ast::Expression& expression, int64_t counter_count) {
+            const auto first_counter = m_profile_sites.empty() ? 0 : m_profile_sites.back().first_counter + m_profile_sites.back().counter_count;
+            m_profile_sites.push_back({&function, &expression, first_counter, counter_count});
+            m_profile_counters.emplace(&expression, first_counter);
+        };
+        for (const auto& expression : scope.expressions) {
+            switch (expression->get_type()) {
+                case ast::expr_operation_string:
+                    if (static_cast<const ast::OperationExpression&>(*expression).operation == lang::op_call) add_site(*expression, 1);
+                    break;
+                case ast::expr_scope:
+                    add_profile_sites(function, static_cast<const ast::Scope&>(*expression));
+                    break;
+                case ast::expr_if:
+                {
+                    const auto& if_expr = static_cast<const ast::IfExpression&>(*expression);
+                    // one counter per branch and one for the else
+                    add_site(if_expr, static_cast<int64_t>(if_expr.else_if.size()) + 2);
+                    add_profile_sites(function, if_expr.first_if.condition);
+                    add_profile_sites(function, if_expr.first_if.body);
+                    for (const auto& branch : if_expr.else_if) {
+                        add_profile_sites(function, branch.condition);
+                        add_profile_sites(function, branch.body);
+                    }
+                    add_profile_sites(function, if_expr.else_body);
+                }
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    void Interpreter::count(const ast::Expression& expression, int64_t offset) {
+        if (!m_counters) return;
+        m_counters[m_profile_counters.at(&expression) + offset].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    profile::Profile Interpreter::profile() const {
+        profile::Profile result;
+        for (const auto& state : m_functions) {
+            result.functions[state->function->name] = state->calls.load(std::memory_order_relaxed);
+        }
+        for (const auto& site : m_profile_sites) {
+            const auto key = profile::Profile::site(site.function->name, site.expression->location);
+            if (site.expression->get_type() == ast::expr_if) {
+                auto& counts = result.branches[key];
+                for (int64_t i = 0; i < site.counter_count; ++i) {
+                    counts.push_back(m_counters[site.first_counter + i].load(std::memory_order_relaxed));
+                }
+            } else {
+                result.call_sites[key] = m_counters[site.first_counter].load(std::memory_order_relaxed);
+            }
+        }
+        return result;
+    }
+
+    void Interpreter::run(const compiler::Code& code, DataStack& stack) {
+        const auto instructions = code.instructions.data();
+        const auto size = static_cast<int64_t>(code.instructions.size());
+        for (int64_t pc = 0; pc < size; ++pc) {
+            const auto& instruction = instructions[pc];
+            switch (instruction.operation) {
+                case lang::op_jump:
+                    pc = instruction.operand - 1;
+                    break;
+                case lang::op_jump_if:
+                    if (pop(stack)) pc = instruction.operand - 1;
+                    break;
+                case lang::op_jump_unless:
+                    if (!pop(stack)) pc = instruction.operand - 1;
+                    break;
+                default:
+                    execute(instruction.operation, instruction.operand, stack);
+                    break;
+            }
+        }
+    }
+
+    void Interpreter::execute(const ast::Scope& scope, DataStack& stack) {
+        for (const auto& expression : scope.expressions) {
+            execute(*expression, stack);
+        }
+    }
+
+    void Interpreter::execute(const ast::Expression& expression, DataStack& stack) {
+        switch (expression.get_type()) {
+            case ast::expr_operation:
+            case ast::expr_operation_string:
+            case ast::expr_operation_int:
+                execute(static_cast<const ast::OperationExpression&>(expression), stack);
+                break;
+            case ast::expr_scope:
+                execute(static_cast<const ast::Scope&>(expression), stack);
+                break;
+            case ast::expr_if:
+                execute(static_cast<const ast::IfExpression&>(expression), stack);
+                break;
+            case ast::expr_while:
+                throw RuntimeException{"While not supported yet."};
+            case ast::expr_none:
+                break;
+        }
+    }
+
+    void Interpreter::execute(const ast::OperationExpression& operation, DataStack& stack) {
+        switch (operation.get_type()) {
+            case ast::expr_operation_int:
+                execute(operation.operation, static_cast<const ast::IntOperationExpression&>(operation).value, stack);
+                break;
+            case ast::expr_operation_string:
+            {
+                const auto& name = static_cast<const ast::StringOperationExpression&>(operation).value;
+                if (operation.operation == lang::op_call) count(operation);
+                execute(operation.operation, operation.operation == lang::op_join ? 0 : m_function_ids.at(name), stack);
+            }
+                break;
+            default:
+                execute(operation.operation, 0, stack);
+                break;
+        }
+    }
+
+    void Interpreter::execute(const lang::Operation operation, const int64_t operand, DataStack& stack) {
+        static_assert(lang::operation_count == 34);
+        switch (operation) {
+            case lang::op_none:
+                break;
+            case lang::op_push_int:
+                stack.push_back(operand);
+                break;
+            case lang::op_push_str:
+            {
+                const auto& literal = m_program.strings[operand];
+                push_string(stack, std::string_view{m_program.data}.substr(literal.offset, literal.size));
+            }
+                break;
+            case lang::op_call:
+                call(*m_functions[operand], stack);
+                break;
+            case lang::op_add:
+            {
+                auto b = pop(stack);
+                stack.back() += b;
+            }
+                break;
+            case lang::op_sub:
+            {
+                auto b = pop(stack);
+                stack.back() -= b;
+            }
+                break;
+            case lang::op_mul:
+            {
+                auto b = pop(stack);
+                stack.back() *= b;
+            }
+                break;
+            case lang::op_div:
+            {
+                auto b = pop(stack);
+                if (b == 0) throw RuntimeException{"Division by zero."};
+                stack.back() /= b;
+            }
+                break;
+            case lang::op_and:
+            {
+                auto b = pop(stack);
+                stack.back() &= b;
+            }
+                break;
+            case lang::op_or:
+            {
+                auto b = pop(stack);
+                stack.back() |= b;
+            }
+                break;
+            case lang::op_xor:
+            {
+                auto b = pop(stack);
+                stack.back() ^= b;
+            }
+                break;
+            case lang::op_not:
+                stack.back() = ~stack.back();
+                break;
+            case lang::op_drop:
+                stack.resize(stack.size() - operand);
+                break;
+            case lang::op_dup:
+            {
+                const auto slots = operand;
+                for (auto i = 0; i < slots; ++i) {
+                    stack.push_back(stack[stack.size() - slots]);
+                }
+            }
+                break;
+            case lang::op_swap:
+            {
+                const auto [lower, upper] = lang::unpack_slot_counts(operand);
+                std::rotate(stack.end() - lower - upper, stack.end() - upper, stack.end());
+            }
+                break;
+            case lang::op_equal:
+            {
+                auto b = pop(stack);
+                stack.back() = stack.back() == b;
+            }
+                break;
+            case lang::op_less:
+            {
+                auto b = pop(stack);
+                stack.back() = stack.back() < b;
+            }
+                break;
+            case lang::op_greater:
+            {
+                auto b = pop(stack);
+                stack.back() = stack.back() > b;
+            }
+                break;
+            case lang::op_spawn:
+                spawn(*m_functions[operand], stack);
+                break;
+            case lang::op_join:
+                join(stack);
+                break;
+            case lang::op_str_len:
+                stack.push_back(static_cast<value_t>(pop_string(stack).size()));
+                break;
+            case lang::op_str_compare:
+            {
+                auto b = pop_string(stack);
+                auto a = pop_string(stack);
+                stack.push_back(a.compare(b));
+            }
+                break;
+            case lang::op_str_slice:
+            {
+                auto count = pop(stack);
+                auto start = pop(stack);
+                auto str = pop_string(stack);
+                if (start < 0 || count < 0 || start > static_cast<value_t>(str.size()) || count > static_cast<value_t>(str.size()) - start)
+                    throw RuntimeException{"String slice out of range."};
+                push_string(stack, str.substr(start, count));
+            }
+                break;
+            case lang::op_buf_alloc:
+            {
+                auto size = pop(stack);
+                if (size < 0) throw RuntimeException{"Negative buffer size."};
+                Buffer buffer{m_arena.allocate(size), size};
+                kernels::fill(buffer.data, buffer.size, 0);
+                push_buffer(stack, buffer);
+            }
+                break;
+            case lang::op_buf_fill:
+            {
+                auto value = pop(stack);
+                auto buffer = pop_buffer(stack);
+                kernels::fill(buffer.data, buffer.size, value);
+            }
+                break;
+            case lang::op_buf_copy:
+            {
+                auto destination = pop_buffer(stack);
+                auto source = pop_buffer(stack);
+                check_same_size(source, destination);
+                kernels::copy(destination.data, source.data, source.size);
+            }
+                break;
+            case lang::op_buf_sum:
+            {
+                auto buffer = pop_buffer(stack);
+                stack.push_back(kernels::sum(buffer.data, buffer.size));
+            }
+                break;
+            case lang::op_buf_min:
+            case lang::op_buf_max:
+            {
+                auto buffer = pop_buffer(stack);
+                if (buffer.size == 0) throw RuntimeException{"Extreme of empty buffer."};
+                stack.push_back(operation == lang::op_buf_min ? kernels::min(buffer.data, buffer.size) : kernels::max(buffer.data, buffer.size));
+            }
+                break;
+            case lang::op_buf_add:
+            case lang::op_buf_mul:
+            {
+                auto source = pop_buffer(stack);
+                auto destination = pop_buffer(stack);
+                check_same_size(source, destination);
+                if (operation == lang::op_buf_add) {
+                    kernels::add(destination.data, source.data, source.size);
+                } else {
+                    kernels::mul(destination.data, source.data, source.size);
+                }
+                push_buffer(stack, destination);
+            }
+                break;
+            case lang::op_jump:
+            case lang::op_jump_if:
+            case lang::op_jump_unless:
+                throw RuntimeException{"Jumps are only valid in compiled code."};
+        }
+    }
+
+    void Interpreter::execute(const ast::IfExpression& if_expr, DataStack& stack) {
+        execute(if_expr.first_if.condition, stack);
+        if (pop(stack)) {
+            count(if_expr);
+            execute(if_expr.first_if.body, stack);
+            return;
+        }
+        for (int64_t i = 0; i < static_cast<int64_t>(if_expr.else_if.size()); ++i) {
+            execute(if_expr.else_if[i].condition, stack);
+            if (pop(stack)) {
+                count(if_expr, i + 1);
+                execute(if_expr.else_if[i].body, stack);
+                return;
+            }
+        }
+        count(if_expr, static_cast<int64_t>(if_expr.else_if.size()) + 1);
+        execute(if_expr.else_body, stack);
+    }
+
+    void Interpreter::spawn(FunctionState& state, DataStack& stack) {
+        // the task is owned by its handle on the stack until it gets joined
+        auto task = new Task;
+        task->stack = m_stack_pool.acquire();
+        const auto first_argument = stack.end() - type::get_slot_count(state.function->signature.in);
+        task->stack.insert(task->stack.end(), first_argument, stack.end());
+        stack.erase(first_argument, stack.end());
+        task->body = [this, &state](DataStack& task_stack) {
+            try {
+                call(state, task_stack);
+            } catch (...) {
+                finish_task();
+                throw;
+            }
+            finish_task();
+        };
+        {
+            std::lock_guard lock{m_tasks_mutex};
+            m_tasks.insert(task);
+            ++m_running_tasks;
+        }
+        m_scheduler.submit(*task);
+        stack.push_back(reinterpret_cast<value_t>(task));
+    }
+
+    void Interpreter::join(DataStack& stack) {
+        std::unique_ptr<Task> task{reinterpret_cast<Task*>(pop(stack))};
+        {
+            std::lock_guard lock{m_tasks_mutex};
+            m_tasks.erase(task.get());
+        }
+        m_scheduler.join(*task);
+        stack.insert(stack.end(), task->stack.begin(), task->stack.end());
+        m_stack_pool.release(std::move(task->stack));
+    }
+
+    void Interpreter::finish_task() {
+        std::lock_guard lock{m_tasks_mutex};
+        --m_running_tasks;
+        m_tasks_finished.notify_all();
+    }
+}
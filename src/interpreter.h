@@ -0,0 +1,156 @@
+#pragma once
+
+#include <string>
+#include <stdexcept>
+#include <ostream>
+#include <chrono>
+#include <unordered_set>
+
+#include "ast.h"
+#include "runtime.h"
+#include "compiler.h"
+#include "perf_map.h"
+#include "profile.h"
+
+namespace sorth::runtime {
+
+    enum Tier {
+        tier_interpreted,
+        tier_compiling,
+        tier_compiled,
+    };
+
+    // Execution state of a single function. Every function starts out interpreted on its AST,
+    // once it gets hot it is compiled in the background and swapped in for later calls.
+    struct FunctionState {
+        const ast::Function* function;
+        std::atomic<int64_t> calls{0};
+        // recursive self calls, the only way to loop until while is supported
+        std::atomic<int64_t> back_edges{0};
+        std::atomic<Tier> tier{tier_interpreted};
+        std::atomic<const compiler::Code*> compiled{nullptr};
+        std::unique_ptr<compiler::Code> code{};
+        // native entry points registered in the perf map, only set when symbolisation is enabled
+        Trampoline interpreted_trampoline{nullptr};
+        Trampoline compiled_trampoline{nullptr};
+        int64_t promoted_at{0};
+        std::chrono::microseconds compile_time{0};
+    };
+
+    struct InterpreterOptions {
+        int64_t promotion_threshold = 1000;
+        // registers every function in the perf map when set
+        PerfMap* perf_map = nullptr;
+        // counts calls and branches for a profile, functions stay interpreted
+        bool instrument = false;
+        // profile of an earlier run, profiled functions get compiled up front, hottest first
+        const profile::Profile* profile = nullptr;
+    };
+
+    // Executes a type checked program, promoting hot functions from the AST interpreter to compiled code
+    class Interpreter {
+
+    public:
+
+        Interpreter(const ast::Program& program, Scheduler& scheduler, StackPool& stack_pool, Arena& arena,
+                    const InterpreterOptions& options = {});
+
+        Interpreter(const Interpreter&) = delete;
+
+        Interpreter& operator=(const Interpreter&) = delete;
+
+        ~Interpreter();
+
+        void call(const std::string& name, DataStack& stack);
+
+        // Per function counters and tier transitions
+        void report(std::ostream& os) const;
+
+        // Counts collected by an instrumented interpreter
+        profile::Profile profile() const;
+
+    private:
+        const ast::Program& m_program;
+        Scheduler& m_scheduler;
+        StackPool& m_stack_pool;
+        Arena& m_arena;
+        InterpreterOptions m_options;
+        compiler::CompileOptions m_compile_options;
+        ExecutableMemory m_executable_memory;
+
+        std::vector<std::unique_ptr<FunctionState>> m_functions;
+        std::unordered_map<std::string, int64_t> m_function_ids;
+
+        // instrumentation, every call site and if gets a range of counters
+        struct ProfileSite {
+            const ast::Function* function;
+            const ast::Expression* expression;
+            int64_t first_counter;
+            int64_t counter_count;
+        };
+        std::vector<ProfileSite> m_profile_sites;
+        std::unordered_map<const ast::Expression*, int64_t> m_profile_counters;
+        std::unique_ptr<std::atomic<int64_t>[]> m_counters;
+
+        // spawned tasks that were not joined yet and the number of them still running, the interpreter
+        // waits for all of them to finish before it goes away
+        std::mutex m_tasks_mutex;
+        std::condition_variable m_tasks_finished;
+        std::unordered_set<Task*> m_tasks;
+        int64_t m_running_tasks{0};
+
+        // background compilation
+        std::mutex m_compile_mutex;
+        std::condition_variable m_compile_ready;
+        std::vector<FunctionState*> m_compile_queue;
+        bool m_stop_compiler{false};
+        std::thread m_compiler;
+
+        void call(FunctionState& state, DataStack& stack);
+
+        std::string symbol_name(const FunctionState& state, const char* tier) const;
+
+        struct CallFrame {
+            Interpreter* interpreter;
+            const FunctionState* state;
+            const compiler::Code* code;
+            DataStack* stack;
+            std::exception_ptr exception{};
+        };
+
+        static void enter(void* frame) noexcept;
+
+        void promote(FunctionState& state);
+
+        void compile(FunctionState& state);
+
+        void add_profile_sites(const ast::Function& function, const ast::Scope& scope);
+
+        void count(const ast::Expression& expression, int64_t offset = 0);
+
+        void compile_in_background();
+
+        void run(const compiler::Code& code, DataStack& stack);
+
+        void execute(const ast::Scope& scope, DataStack& stack);
+
+        void execute(const ast::Expression& expression, DataStack& stack);
+
+        void execute(const ast::OperationExpression& operation, DataStack& stack);
+
+        void execute(const ast::IfExpression& if_expr, DataStack& stack);
+
+        // shared by both tiers, operand is the immediate value or the function id
+        void execute(lang::Operation operation, int64_t operand, DataStack& stack);
+
+        void spawn(FunctionState& state, DataStack& stack);
+
+        void join(DataStack& stack);
+
+        void finish_task();
+    };
+
+    struct RuntimeException : public std::runtime_error {
+        explicit RuntimeException(const std::string& message) : std::runtime_error(message) {}
+    };
+}
@@ -0,0 +1,287 @@
+#include <cmath>
+#include <charconv>
+
+#include "json.h"
+
+namespace sorth::json {
+
+    bool Value::as_bool() const {
+        if (auto value = std::get_if<bool>(&m_value)) return *value;
+        throw JsonException{"Expected bool."};
+    }
+
+    int64_t Value::as_int() const {
+        if (auto value = std::get_if<double>(&m_value)) return static_cast<int64_t>(*value);
+        throw JsonException{"Expected number."};
+    }
+
+    const std::string& Value::as_string() const {
+        if (auto value = std::get_if<std::string>(&m_value)) return *value;
+        throw JsonException{"Expected string."};
+    }
+
+    const Value::Array& Value::as_array() const {
+        if (auto value = std::get_if<Array>(&m_value)) return *value;
+        throw JsonException{"Expected array."};
+    }
+
+    const Value& Value::operator[](std::string_view key) const {
+        static const Value null{};
+        if (auto object = std::get_if<Object>(&m_value)) {
+            for (const auto& [name, value] : *object) {
+                if (name == key) return value;
+            }
+        }
+        return null;
+    }
+
+    static void dump_string(const std::string& value, std::string& out) {
+        out += '"';
+        for (const char c : value) {
+            switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        static constexpr char hex[] = "0123456789abcdef";
+                        out += "\\u00";
+                        out += hex[c >> 4];
+                        out += hex[c & 0xf];
+                    } else {
+                        out += c;
+                    }
+            }
+        }
+        out += '"';
+    }
+
+    void Value::dump(std::string& out) const {
+        switch (m_value.index()) {
+            case 0:
+                out += "null";
+                break;
+            case 1:
+                out += std::get<bool>(m_value) ? "true" : "false";
+                break;
+            case 2:
+            {
+                const auto number = std::get<double>(m_value);
+                if (number == std::floor(number) && std::abs(number) < 1e15) out += std::to_string(static_cast<int64_t>(number));
+                else out += std::to_string(number);
+            }
+                break;
+            case 3:
+                dump_string(std::get<std::string>(m_value), out);
+                break;
+            case 4:
+            {
+                out += '[';
+                bool first = true;
+                for (const auto& value : std::get<Array>(m_value)) {
+                    if (!first) out += ',';
+                    first = false;
+                    value.dump(out);
+                }
+                out += ']';
+            }
+                break;
+            case 5:
+            {
+                out += '{';
+                bool first = true;
+                for (const auto& [name, value] : std::get<Object>(m_value)) {
+                    if (!first) out += ',';
+                    first = false;
+                    dump_string(name, out);
+                    out += ':';
+                    value.dump(out);
+                }
+                out += '}';
+            }
+                break;
+        }
+    }
+
+    std::string Value::dump() const {
+        std::string out;
+        dump(out);
+        return out;
+    }
+
+    class Parser {
+
+    public:
+
+        explicit Parser(std::string_view text) : m_text(text) {}
+
+        Value parse_document() {
+            auto value = parse_value();
+            skip_white_space();
+            if (m_position != m_text.size()) fail("Trailing characters");
+            return value;
+        }
+
+    private:
+        std::string_view m_text;
+        size_t m_position{0};
+
+        [[noreturn]] void fail(const std::string& message) const {
+            throw JsonException{message + " at offset " + std::to_string(m_position)};
+        }
+
+        void skip_white_space() {
+            while (m_position < m_text.size() && (m_text[m_position] == ' ' || m_text[m_position] == '\t' || m_text[m_position] == '\n' || m_text[m_position] == '\r')) {
+                ++m_position;
+            }
+        }
+
+        char peek() {
+            skip_white_space();
+            if (m_position >= m_text.size()) fail("Unexpected end of input");
+            return m_text[m_position];
+        }
+
+        void expect(char c) {
+            if (peek() != c) fail(std::string{"Expected '"} + c + "'");
+            ++m_position;
+        }
+
+        bool consume_literal(std::string_view literal) {
+            if (m_text.substr(m_position, literal.size()) != literal) return false;
+            m_position += literal.size();
+            return true;
+        }
+
+        Value parse_value() {
+            switch (peek()) {
+                case '{':
+                    return parse_object();
+                case '[':
+                    return parse_array();
+                case '"':
+                    return parse_string();
+                default:
+                    if (consume_literal("true")) return true;
+                    if (consume_literal("false")) return false;
+                    if (consume_literal("null")) return nullptr;
+                    return parse_number();
+            }
+        }
+
+        Value parse_object() {
+            expect('{');
+            Value::Object object;
+            if (peek() == '}') {
+                ++m_position;
+                return object;
+            }
+            while (true) {
+                if (peek() != '"') fail("Expected member name");
+                auto name = parse_string();
+                expect(':');
+                object.emplace_back(std::move(name), parse_value());
+                if (peek() == '}') {
+                    ++m_position;
+                    return object;
+                }
+                expect(',');
+            }
+        }
+
+        Value parse_array() {
+            expect('[');
+            Value::Array array;
+            if (peek() == ']') {
+                ++m_position;
+                return array;
+            }
+            while (true) {
+                array.push_back(parse_value());
+                if (peek() == ']') {
+                    ++m_position;
+                    return array;
+                }
+                expect(',');
+            }
+        }
+
+        static void append_utf8(std::string& out, uint32_t code_point) {
+            if (code_point < 0x80) {
+                out += static_cast<char>(code_point);
+            } else if (code_point < 0x800) {
+                out += static_cast<char>(0xc0 | (code_point >> 6));
+                out += static_cast<char>(0x80 | (code_point & 0x3f));
+            } else if (code_point < 0x10000) {
+                out += static_cast<char>(0xe0 | (code_point >> 12));
+                out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3f));
+                out += static_cast<char>(0x80 | (code_point & 0x3f));
+            } else {
+                out += static_cast<char>(0xf0 | (code_point >> 18));
+                out += static_cast<char>(0x80 | ((code_point >> 12) & 0x3f));
+                out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3f));
+                out += static_cast<char>(0x80 | (code_point & 0x3f));
+            }
+        }
+
+        uint32_t parse_hex4() {
+            if (m_position + 4 > m_text.size()) fail("Invalid escape");
+            uint32_t value = 0;
+            auto result = std::from_chars(m_text.data() + m_position, m_text.data() + m_position + 4, value, 16);
+            if (result.ptr != m_text.data() + m_position + 4) fail("Invalid escape");
+            m_position += 4;
+            return value;
+        }
+
+        std::string parse_string() {
+            expect('"');
+            std::string out;
+            while (true) {
+                if (m_position >= m_text.size()) fail("Unterminated string");
+                const char c = m_text[m_position++];
+                if (c == '"') return out;
+                if (c != '\\') {
+                    out += c;
+                    continue;
+                }
+                if (m_position >= m_text.size()) fail("Unterminated string");
+                switch (m_text[m_position++]) {
+                    case '"': out += '"'; break;
+                    case '\\': out += '\\'; break;
+                    case '/': out += '/'; break;
+                    case 'b': out += '\b'; break;
+                    case 'f': out += '\f'; break;
+                    case 'n': out += '\n'; break;
+                    case 'r': out += '\r'; break;
+                    case 't': out += '\t'; break;
+                    case 'u':
+                    {
+                        auto code_point = parse_hex4();
+                        // surrogate pair
+                        if (code_point >= 0xd800 && code_point < 0xdc00 && consume_literal("\\u")) {
+                            code_point = 0x10000 + ((code_point - 0xd800) << 10) + (parse_hex4() - 0xdc00);
+                        }
+                        append_utf8(out, code_point);
+                    }
+                        break;
+                    default:
+                        fail("Invalid escape");
+                }
+            }
+        }
+
+        Value parse_number() {
+            double value = 0;
+            auto result = std::from_chars(m_text.data() + m_position, m_text.data() + m_text.size(), value);
+            if (result.ec != std::errc{}) fail("Invalid value");
+            m_position = result.ptr - m_text.data();
+            return value;
+        }
+    };
+
+    Value Value::parse(std::string_view text) {
+        return Parser{text}.parse_document();
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <variant>
+#include <utility>
+#include <stdexcept>
+
+namespace sorth::json {
+
+    // Minimal JSON document model, just enough for the language server protocol
+    class Value {
+
+    public:
+
+        using Array = std::vector<Value>;
+        using Object = std::vector<std::pair<std::string, Value>>;
+
+        Value() = default;
+
+        Value(std::nullptr_t) {}
+
+        Value(bool value) : m_value(value) {}
+
+        Value(int64_t value) : m_value(static_cast<double>(value)) {}
+
+        Value(int value) : m_value(static_cast<double>(value)) {}
+
+        Value(double value) : m_value(value) {}
+
+        Value(const char* value) : m_value(std::string{value}) {}
+
+        Value(std::string value) : m_value(std::move(value)) {}
+
+        Value(Array value) : m_value(std::move(value)) {}
+
+        Value(Object value) : m_value(std::move(value)) {}
+
+        bool is_null() const { return std::holds_alternative<std::nullptr_t>(m_value); }
+
+        bool is_string() const { return std::holds_alternative<std::string>(m_value); }
+
+        bool is_number() const { return std::holds_alternative<double>(m_value); }
+
+        bool is_object() const { return std::holds_alternative<Object>(m_value); }
+
+        bool as_bool() const;
+
+        int64_t as_int() const;
+
+        const std::string& as_string() const;
+
+        const Array& as_array() const;
+
+        // member lookup, yields null for missing members and non-objects
+        const Value& operator[](std::string_view key) const;
+
+        std::string dump() const;
+
+        static Value parse(std::string_view text);
+
+    private:
+        std::variant<std::nullptr_t, bool, double, std::string, Array, Object> m_value{nullptr};
+
+        void dump(std::string& out) const;
+    };
+
+    struct JsonException : public std::runtime_error {
+        explicit JsonException(const std::string& message) : std::runtime_error(message) {}
+    };
+}
@@ -0,0 +1,181 @@
+#include <cstring>
+#include <algorithm>
+
+#include "kernels.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SORTH_HAS_AVX2_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace sorth::runtime::kernels {
+
+    namespace scalar {
+
+        // arithmetic wraps on overflow like the vector kernels do
+
+        static void fill(int64_t* destination, int64_t size, int64_t value) {
+            std::fill(destination, destination + size, value);
+        }
+
+        static void copy(int64_t* destination, const int64_t* source, int64_t size) {
+            std::memmove(destination, source, size * sizeof(int64_t));
+        }
+
+        static int64_t sum(const int64_t* source, int64_t size) {
+            uint64_t result = 0;
+            for (int64_t i = 0; i < size; ++i) result += static_cast<uint64_t>(source[i]);
+            return static_cast<int64_t>(result);
+        }
+
+        static int64_t min(const int64_t* source, int64_t size) {
+            return *std::min_element(source, source + size);
+        }
+
+        static int64_t max(const int64_t* source, int64_t size) {
+            return *std::max_element(source, source + size);
+        }
+
+        static void add(int64_t* destination, const int64_t* source, int64_t size) {
+            for (int64_t i = 0; i < size; ++i) destination[i] = static_cast<int64_t>(static_cast<uint64_t>(destination[i]) + static_cast<uint64_t>(source[i]));
+        }
+
+        static void mul(int64_t* destination, const int64_t* source, int64_t size) {
+            for (int64_t i = 0; i < size; ++i) destination[i] = static_cast<int64_t>(static_cast<uint64_t>(destination[i]) * static_cast<uint64_t>(source[i]));
+        }
+    }
+
+#ifdef SORTH_HAS_AVX2_KERNELS
+    namespace avx2 {
+
+        static constexpr int64_t lanes = 4;
+
+        __attribute__((target("avx2")))
+        static __m256i load(const int64_t* source) {
+            return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source));
+        }
+
+        __attribute__((target("avx2")))
+        static void store(int64_t* destination, __m256i value) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination), value);
+        }
+
+        __attribute__((target("avx2")))
+        static void fill(int64_t* destination, int64_t size, int64_t value) {
+            const auto values = _mm256_set1_epi64x(value);
+            int64_t i = 0;
+            for (; i + lanes <= size; i += lanes) store(destination + i, values);
+            scalar::fill(destination + i, size - i, value);
+        }
+
+        __attribute__((target("avx2")))
+        static void copy(int64_t* destination, const int64_t* source, int64_t size) {
+            // overlapping ranges need memmove semantics
+            if (destination < source + size && source < destination + size) {
+                scalar::copy(destination, source, size);
+                return;
+            }
+            int64_t i = 0;
+            for (; i + lanes <= size; i += lanes) store(destination + i, load(source + i));
+            scalar::copy(destination + i, source + i, size - i);
+        }
+
+        __attribute__((target("avx2")))
+        static int64_t sum(const int64_t* source, int64_t size) {
+            auto accumulator = _mm256_setzero_si256();
+            int64_t i = 0;
+            for (; i + lanes <= size; i += lanes) accumulator = _mm256_add_epi64(accumulator, load(source + i));
+            alignas(32) int64_t partial[lanes];
+            store(partial, accumulator);
+            const auto rest = static_cast<uint64_t>(scalar::sum(source + i, size - i));
+            return static_cast<int64_t>(static_cast<uint64_t>(scalar::sum(partial, lanes)) + rest);
+        }
+
+        template <bool is_min>
+        __attribute__((target("avx2")))
+        static int64_t reduce_extreme(const int64_t* source, int64_t size) {
+            if (size < lanes) return is_min ? scalar::min(source, size) : scalar::max(source, size);
+            auto extreme = load(source);
+            int64_t i = lanes;
+            for (; i + lanes <= size; i += lanes) {
+                const auto values = load(source + i);
+                // there is no 64-bit min/max in avx2, select on the comparison instead
+                const auto greater = _mm256_cmpgt_epi64(extreme, values);
+                extreme = is_min ? _mm256_blendv_epi8(extreme, values, greater) : _mm256_blendv_epi8(values, extreme, greater);
+            }
+            alignas(32) int64_t partial[lanes];
+            store(partial, extreme);
+            auto result = is_min ? scalar::min(partial, lanes) : scalar::max(partial, lanes);
+            if (i == size) return result;
+            const auto rest = is_min ? scalar::min(source + i, size - i) : scalar::max(source + i, size - i);
+            return is_min ? std::min(result, rest) : std::max(result, rest);
+        }
+
+        static int64_t min(const int64_t* source, int64_t size) {
+            return reduce_extreme<true>(source, size);
+        }
+
+        static int64_t max(const int64_t* source, int64_t size) {
+            return reduce_extreme<false>(source, size);
+        }
+
+        __attribute__((target("avx2")))
+        static void add(int64_t* destination, const int64_t* source, int64_t size) {
+            int64_t i = 0;
+            for (; i + lanes <= size; i += lanes) store(destination + i, _mm256_add_epi64(load(destination + i), load(source + i)));
+            scalar::add(destination + i, source + i, size - i);
+        }
+
+        __attribute__((target("avx2")))
+        static void mul(int64_t* destination, const int64_t* source, int64_t size) {
+            int64_t i = 0;
+            for (; i + lanes <= size; i += lanes) {
+                // 64-bit multiplication from 32-bit halves: lo*lo + ((lo*hi + hi*lo) << 32)
+                const auto a = load(destination + i);
+                const auto b = load(source + i);
+                const auto low = _mm256_mul_epu32(a, b);
+                const auto cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b), _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+                store(destination + i, _mm256_add_epi64(low, _mm256_slli_epi64(cross, 32)));
+            }
+            scalar::mul(destination + i, source + i, size - i);
+        }
+    }
+
+    static bool use_avx2() {
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+    }
+
+#define SORTH_DISPATCH(kernel, ...) return use_avx2() ? avx2::kernel(__VA_ARGS__) : scalar::kernel(__VA_ARGS__)
+#else
+#define SORTH_DISPATCH(kernel, ...) return scalar::kernel(__VA_ARGS__)
+#endif
+
+    void fill(int64_t* destination, int64_t size, int64_t value) {
+        SORTH_DISPATCH(fill, destination, size, value);
+    }
+
+    void copy(int64_t* destination, const int64_t* source, int64_t size) {
+        SORTH_DISPATCH(copy, destination, source, size);
+    }
+
+    int64_t sum(const int64_t* source, int64_t size) {
+        SORTH_DISPATCH(sum, source, size);
+    }
+
+    int64_t min(const int64_t* source, int64_t size) {
+        SORTH_DISPATCH(min, source, size);
+    }
+
+    int64_t max(const int64_t* source, int64_t size) {
+        SORTH_DISPATCH(max, source, size);
+    }
+
+    void add(int64_t* destination, const int64_t* source, int64_t size) {
+        SORTH_DISPATCH(add, destination, source, size);
+    }
+
+    void mul(int64_t* destination, const int64_t* source, int64_t size) {
+        SORTH_DISPATCH(mul, destination, source, size);
+    }
+}
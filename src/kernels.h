@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+
+namespace sorth::runtime::kernels {
+
+    // Bulk operations over int64 buffers. Every kernel has an AVX2 implementation,
+    // which is picked at runtime if the cpu supports it, and a scalar fallback.
+
+    void fill(int64_t* destination, int64_t size, int64_t value);
+
+    void copy(int64_t* destination, const int64_t* source, int64_t size);
+
+    int64_t sum(const int64_t* source, int64_t size);
+
+    // size has to be greater than zero
+    int64_t min(const int64_t* source, int64_t size);
+
+    int64_t max(const int64_t* source, int64_t size);
+
+    // element-wise destination[i] op= source[i]
+    void add(int64_t* destination, const int64_t* source, int64_t size);
+
+    void mul(int64_t* destination, const int64_t* source, int64_t size);
+}
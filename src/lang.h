@@ -5,12 +5,13 @@
 
 #include <cstdint>
 #include <cassert>
+#include <utility>
 
 #include "type.h"
 
 namespace sorth::lang {
 
-    static constexpr int64_t keyword_count = 8;
+    static constexpr int64_t keyword_count = 10;
     enum Keyword {
         keyword_function,
         keyword_const,
@@ -20,9 +21,12 @@ namespace sorth::lang {
         keyword_else,
         keyword_else_if,
         keyword_while,
+        // tasks
+        keyword_spawn,
+        keyword_join,
     };
 
-    static constexpr int64_t intrinsic_count = 15;
+    static constexpr int64_t intrinsic_count = 24;
     enum Intrinsic : int64_t {
         intrinsic_invalid,
         // arithmetic
@@ -43,12 +47,24 @@ namespace sorth::lang {
         intrinsic_equal,
         intrinsic_less,
         intrinsic_greater,
+        // strings
+        intrinsic_str_len,
+        intrinsic_str_compare,
+        intrinsic_str_slice,
+        // buffers
+        intrinsic_buf_alloc,
+        intrinsic_buf_fill,
+        intrinsic_buf_copy,
+        intrinsic_buf_sum,
+        intrinsic_buf_min,
+        intrinsic_buf_max,
     };
 
-    static constexpr int64_t operation_count = 17;
+    static constexpr int64_t operation_count = 34;
     enum Operation : int64_t {
         op_none,
         op_push_int,
+        op_push_str,
         op_call,
         // arithmetic
         op_add,
@@ -68,13 +84,39 @@ namespace sorth::lang {
         op_equal,
         op_less,
         op_greater,
+        // tasks
+        op_spawn,
+        op_join,
+        // strings
+        op_str_len,
+        op_str_compare,
+        op_str_slice,
+        // buffers
+        op_buf_alloc,
+        op_buf_fill,
+        op_buf_copy,
+        op_buf_sum,
+        op_buf_min,
+        op_buf_max,
+        op_buf_add,
+        op_buf_mul,
+        // lowered control flow, only emitted by the compiler
+        op_jump,
+        op_jump_if,
+        op_jump_unless,
     };
 
-    static int64_t get_intrinsic_input_count(Intrinsic intrinsic) {
-        static_assert(intrinsic_count == 15);
+    inline int64_t get_intrinsic_input_count(Intrinsic intrinsic) {
+        static_assert(intrinsic_count == 24);
         switch (intrinsic) {
             case intrinsic_drop:
             case intrinsic_dup:
+            case intrinsic_not:
+            case intrinsic_str_len:
+            case intrinsic_buf_alloc:
+            case intrinsic_buf_sum:
+            case intrinsic_buf_min:
+            case intrinsic_buf_max:
                 return 1;
             case intrinsic_add:
             case intrinsic_sub:
@@ -84,18 +126,22 @@ namespace sorth::lang {
             case intrinsic_and:
             case intrinsic_or:
             case intrinsic_xor:
-            case intrinsic_not:
             case intrinsic_equal:
             case intrinsic_less:
             case intrinsic_greater:
+            case intrinsic_str_compare:
+            case intrinsic_buf_fill:
+            case intrinsic_buf_copy:
                 return 2;
+            case intrinsic_str_slice:
+                return 3;
             default:
                 return -1;
         }
     }
 
-    static Operation intrinsic_to_operation(Intrinsic intrinsic) {
-        static_assert(intrinsic_count == 15);
+    inline Operation intrinsic_to_operation(Intrinsic intrinsic) {
+        static_assert(intrinsic_count == 24);
         switch (intrinsic) {
             case intrinsic_invalid:
                 return op_none;
@@ -127,39 +173,74 @@ namespace sorth::lang {
                 return op_less;
             case intrinsic_greater:
                 return op_greater;
+            case intrinsic_str_len:
+                return op_str_len;
+            case intrinsic_str_compare:
+                return op_str_compare;
+            case intrinsic_str_slice:
+                return op_str_slice;
+            case intrinsic_buf_alloc:
+                return op_buf_alloc;
+            case intrinsic_buf_fill:
+                return op_buf_fill;
+            case intrinsic_buf_copy:
+                return op_buf_copy;
+            case intrinsic_buf_sum:
+                return op_buf_sum;
+            case intrinsic_buf_min:
+                return op_buf_min;
+            case intrinsic_buf_max:
+                return op_buf_max;
         }
         return op_none;
     }
 
-    static type::TypeSignature get_intrinsic_signature(Intrinsic intrinsic, const type::TypeStack& type_stack) {
-        static_assert(intrinsic_count == 15);
+    // drop, dup and swap carry the slot counts of the values they move
+    inline int64_t pack_slot_counts(int64_t lower, int64_t upper) {
+        return (lower << 32) | upper;
+    }
+
+    inline std::pair<int64_t, int64_t> unpack_slot_counts(int64_t packed) {
+        return {packed >> 32, packed & 0xffffffff};
+    }
+
+    inline type::TypeSignature get_intrinsic_signature(Intrinsic intrinsic, const type::TypeStack& type_stack) {
+        static_assert(intrinsic_count == 24);
         assert(type_stack.size() >= get_intrinsic_input_count(intrinsic));
         switch (intrinsic) {
             case intrinsic_add:
-            case intrinsic_sub:
             case intrinsic_mul:
+                // element-wise on buffers, the result is written into the lower one
+                if (type_stack.back() == type::buf_t)
+                    return {{type::buf_t, type::buf_t}, {type::buf_t}};
+                return {{type::int_t, type::int_t}, {type::int_t}};
+            case intrinsic_sub:
             case intrinsic_div:
             case intrinsic_and:
             case intrinsic_or:
             case intrinsic_xor:
-            case intrinsic_not:
                 // todo: dynamic typing for add to support i.e. floats
                 return {{type::int_t, type::int_t}, {type::int_t}};
                 break;
+            case intrinsic_not:
+                return {{type::int_t}, {type::int_t}};
             case intrinsic_drop:
             {
+                // a task is owned by its handle, it has to be joined exactly once
                 auto first = type_stack.back();
+                if (type::is_task_type(first)) return {{type::invalid_t}, {}};
                 return {{first}, {}};
             }
             case intrinsic_swap:
             {
                 auto first = type_stack.back();
-                auto second = type_stack[type_stack.size() - 1];
+                auto second = type_stack[type_stack.size() - 2];
                 return {{second, first}, {first, second}};
             }
             case intrinsic_dup:
             {
                 auto first = type_stack.back();
+                if (type::is_task_type(first)) return {{type::invalid_t}, {type::invalid_t, type::invalid_t}};
                 return {{first}, {first, first}};
             }
             case intrinsic_equal:
@@ -167,6 +248,26 @@ namespace sorth::lang {
             case intrinsic_greater:
                 // todo: support different types
                 return {{type::int_t, type::int_t}, {type::bool_t}};
+            case intrinsic_str_len:
+                return {{type::str_t}, {type::int_t}};
+            case intrinsic_str_compare:
+                return {{type::str_t, type::str_t}, {type::int_t}};
+            case intrinsic_str_slice:
+                // str start count -- str
+                return {{type::str_t, type::int_t, type::int_t}, {type::str_t}};
+            case intrinsic_buf_alloc:
+                // size -- buf, zero initialised
+                return {{type::int_t}, {type::buf_t}};
+            case intrinsic_buf_fill:
+                // buf value --
+                return {{type::buf_t, type::int_t}, {}};
+            case intrinsic_buf_copy:
+                // source destination --
+                return {{type::buf_t, type::buf_t}, {}};
+            case intrinsic_buf_sum:
+            case intrinsic_buf_min:
+            case intrinsic_buf_max:
+                return {{type::buf_t}, {type::int_t}};
             default:
                 return {};
         }
@@ -0,0 +1,177 @@
+#include <charconv>
+
+#include "language_server.h"
+
+namespace sorth::lsp {
+
+    static std::filesystem::path uri_to_path(const std::string& uri) {
+        static constexpr std::string_view scheme = "file://";
+        if (!uri.starts_with(scheme)) return uri;
+        std::string path;
+        for (size_t i = scheme.size(); i < uri.size(); ++i) {
+            // a malformed escape is kept as it is
+            unsigned char decoded = 0;
+            const auto escape = uri.data() + i + 1;
+            if (uri[i] == '%' && i + 2 < uri.size() && std::from_chars(escape, escape + 2, decoded, 16).ptr == escape + 2) {
+                path += static_cast<char>(decoded);
+                i += 2;
+            } else {
+                path += uri[i];
+            }
+        }
+        return path;
+    }
+
+    // protocol positions are zero based, lexer locations start at line 1 and column 1
+    static json::Value to_position(int64_t line, int64_t column) {
+        return json::Value::Object{{"line", line - 1}, {"character", std::max<int64_t>(column - 1, 0)}};
+    }
+
+    std::optional<std::string> LanguageServer::read_message() {
+        int64_t content_length = -1;
+        std::string header;
+        while (std::getline(m_in, header)) {
+            if (!header.empty() && header.back() == '\r') header.pop_back();
+            if (header.empty()) break;
+            static constexpr std::string_view length_header = "Content-Length:";
+            if (header.starts_with(length_header)) {
+                auto begin = header.data() + length_header.size();
+                const auto end = header.data() + header.size();
+                while (begin != end && *begin == ' ') ++begin;
+                if (std::from_chars(begin, end, content_length).ec != std::errc{}) content_length = -1;
+            }
+        }
+        if (!m_in) return std::nullopt;
+        if (content_length < 0) return std::string{};
+        std::string content(content_length, '\0');
+        if (!m_in.read(content.data(), content_length)) return std::nullopt;
+        return content;
+    }
+
+    void LanguageServer::send(const json::Value& message) {
+        const auto content = message.dump();
+        m_out << "Content-Length: " << content.size() << "\r\n\r\n" << content;
+        m_out.flush();
+    }
+
+    void LanguageServer::respond(const json::Value& id, json::Value result) {
+        send(json::Value::Object{{"jsonrpc", "2.0"}, {"id", id}, {"result", std::move(result)}});
+    }
+
+    void LanguageServer::respond_error(const json::Value& id, int64_t code, const std::string& message) {
+        send(json::Value::Object{{"jsonrpc", "2.0"}, {"id", id}, {"error", json::Value::Object{{"code", code}, {"message", message}}}});
+    }
+
+    void LanguageServer::notify(const std::string& method, json::Value params) {
+        send(json::Value::Object{{"jsonrpc", "2.0"}, {"method", method}, {"params", std::move(params)}});
+    }
+
+    void LanguageServer::open(const std::string& uri, std::string text) {
+        auto document = std::make_unique<analysis::Document>(uri_to_path(uri));
+        document->update(std::move(text));
+        m_documents.insert_or_assign(uri, std::move(document));
+        publish_diagnostics(uri);
+    }
+
+    void LanguageServer::change(const std::string& uri, const json::Value::Array& changes) {
+        auto it = m_documents.find(uri);
+        if (it == m_documents.end()) return;
+        auto& document = *it->second;
+        for (const auto& change : changes) {
+            const auto& range = change["range"];
+            if (range.is_null()) {
+                document.update(change["text"].as_string());
+                continue;
+            }
+            const auto& start = range["start"];
+            const auto& end = range["end"];
+            document.edit({start["line"].as_int() + 1, start["character"].as_int() + 1},
+                          {end["line"].as_int() + 1, end["character"].as_int() + 1},
+                          change["text"].as_string());
+        }
+        publish_diagnostics(uri);
+    }
+
+    void LanguageServer::publish_diagnostics(const std::string& uri) {
+        json::Value::Array diagnostics;
+        if (auto it = m_documents.find(uri); it != m_documents.end()) {
+            for (const auto& diagnostic : it->second->diagnostics()) {
+                const auto& location = diagnostic.location;
+                diagnostics.push_back(json::Value::Object{
+                        {"range", json::Value::Object{
+                                {"start", to_position(location.line, location.column)},
+                                {"end", to_position(location.line, location.column + diagnostic.length)},
+                        }},
+                        {"severity", 1},
+                        {"source", "sorth"},
+                        {"message", diagnostic.message},
+                });
+            }
+        }
+        notify("textDocument/publishDiagnostics", json::Value::Object{{"uri", uri}, {"diagnostics", std::move(diagnostics)}});
+    }
+
+    json::Value LanguageServer::hover(const json::Value& params) {
+        auto it = m_documents.find(params["textDocument"]["uri"].as_string());
+        if (it == m_documents.end()) return nullptr;
+        const auto& position = params["position"];
+        const Lexer::Location location{position["line"].as_int() + 1, position["character"].as_int() + 1};
+        const auto signature = it->second->hover(location);
+        if (!signature) return nullptr;
+        return json::Value::Object{{"contents", json::Value::Object{{"kind", "plaintext"}, {"value", *signature}}}};
+    }
+
+    int LanguageServer::run() {
+        while (auto content = read_message()) {
+            std::optional<json::Value> message;
+            try {
+                message = json::Value::parse(*content);
+            } catch (const json::JsonException& ex) {
+                // the id is lost with the rest of the message
+                respond_error(nullptr, -32700, std::string{"Parse error: "} + ex.what());
+                continue;
+            }
+            const auto& method = (*message)["method"];
+            const auto& id = (*message)["id"];
+            const auto& params = (*message)["params"];
+            if (!method.is_string()) {
+                if (!id.is_null()) respond_error(id, -32600, "Invalid request.");
+                continue;
+            }
+            const auto& name = method.as_string();
+            try {
+                if (name == "initialize") {
+                    respond(id, json::Value::Object{
+                            {"capabilities", json::Value::Object{
+                                    // changed ranges only
+                                    {"textDocumentSync", 2},
+                                    {"hoverProvider", true},
+                            }},
+                            {"serverInfo", json::Value::Object{{"name", "sorth"}}},
+                    });
+                } else if (name == "textDocument/didOpen") {
+                    const auto& document = params["textDocument"];
+                    open(document["uri"].as_string(), document["text"].as_string());
+                } else if (name == "textDocument/didChange") {
+                    change(params["textDocument"]["uri"].as_string(), params["contentChanges"].as_array());
+                } else if (name == "textDocument/didClose") {
+                    const auto& uri = params["textDocument"]["uri"].as_string();
+                    m_documents.erase(uri);
+                    publish_diagnostics(uri);
+                } else if (name == "textDocument/hover") {
+                    respond(id, hover(params));
+                } else if (name == "shutdown") {
+                    m_shutdown = true;
+                    respond(id, nullptr);
+                } else if (name == "exit") {
+                    return m_shutdown ? 0 : 1;
+                } else if (!id.is_null()) {
+                    respond_error(id, -32601, "Method not found: " + name);
+                }
+            } catch (const std::exception& ex) {
+                if (!id.is_null()) respond_error(id, -32603, ex.what());
+            }
+        }
+        return 1;
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <istream>
+#include <ostream>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+
+#include "analysis.h"
+#include "json.h"
+
+namespace sorth::lsp {
+
+    // Minimal language server speaking JSON-RPC over stdio: incremental document sync,
+    // diagnostics after every change and function signatures on hover
+    class LanguageServer {
+
+    public:
+
+        LanguageServer(std::istream& in, std::ostream& out) : m_in(in), m_out(out) {}
+
+        // Serves until the client sends exit, returns the process exit code
+        int run();
+
+    private:
+        std::istream& m_in;
+        std::ostream& m_out;
+        bool m_shutdown{false};
+        std::unordered_map<std::string, std::unique_ptr<analysis::Document>> m_documents;
+
+        // content of the next message, empty if its header is malformed, nothing once the input ends
+        std::optional<std::string> read_message();
+
+        void send(const json::Value& message);
+
+        void respond(const json::Value& id, json::Value result);
+
+        void respond_error(const json::Value& id, int64_t code, const std::string& message);
+
+        void notify(const std::string& method, json::Value params);
+
+        void open(const std::string& uri, std::string text);
+
+        // applies full replacements and edited ranges in order
+        void change(const std::string& uri, const json::Value::Array& changes);
+
+        void publish_diagnostics(const std::string& uri);
+
+        json::Value hover(const json::Value& params);
+    };
+}
@@ -5,11 +5,18 @@
 
 #include <filesystem>
 #include <fstream>
+#include <sstream>
+#include <spanstream>
+#include <span>
+#include <memory>
 #include <utility>
 #include <optional>
 #include <cassert>
 #include <tuple>
 #include <unordered_map>
+#include <vector>
+#include <thread>
+#include <algorithm>
 
 #include "lang.h"
 
@@ -67,16 +74,41 @@ namespace sorth {
             Location location{1, 0};
         };
 
-        explicit Lexer(std::filesystem::path path) : m_path(std::move(path)), m_location({1, 0}), m_ifstream(m_path) {
+        explicit Lexer(std::filesystem::path path) : m_path(std::move(path)), m_location({1, 0}), m_stream(std::make_unique<std::ifstream>(m_path)) {
+            next_token();
+        }
+
+        // lexes source already in memory, the path is only used for messages and start is
+        // the location just before the first character, for sources cut out of a larger file
+        Lexer(std::filesystem::path path, std::string source, Location start = {1, 0})
+            : m_path(std::move(path)), m_location(start), m_stream(std::make_unique<std::istringstream>(std::move(source))) {
+            next_token();
+        }
+
+        // lexes source owned by the caller, which has to outlive the lexer
+        Lexer(std::filesystem::path path, std::span<const char> source, Location start = {1, 0})
+            : m_path(std::move(path)), m_location(start), m_stream(std::make_unique<std::ispanstream>(source)) {
+            next_token();
+        }
+
+        // replays tokens lexed up front, see tokenize_parallel
+        Lexer(std::filesystem::path path, std::vector<Token> tokens)
+            : m_path(std::move(path)), m_location({1, 0}), m_tokens(std::move(tokens)) {
             next_token();
         }
 
         const Token& next_token() {
-            m_current_token = interpret_next_token();
+            if (m_stream) {
+                m_current_token = interpret_next_token();
+            } else if (m_next_token < m_tokens.size()) {
+                m_current_token = std::move(m_tokens[m_next_token++]);
+            } else {
+                m_current_token = {tok_eof, "", 0, m_location};
+            }
             return m_current_token;
         }
 
-        const Token& current_token() {
+        const Token& current_token() const {
             return m_current_token;
         }
 
@@ -85,10 +117,68 @@ namespace sorth {
             return os;
         }
 
+        // Lexes the source on up to thread_count threads. Every token ends at the next newline the
+        // latest, even strings, so the source is cut right after newlines and the chunks are lexed
+        // on their own. Lines are corrected while the tokens are stitched together.
+        static std::vector<Token> tokenize_parallel(const std::filesystem::path& path, const std::string& source, size_t thread_count) {
+            static constexpr size_t min_chunk_size = 1 << 20;
+            thread_count = std::clamp<size_t>(std::min(thread_count, source.size() / min_chunk_size), 1, 256);
+            std::vector<size_t> cuts{0};
+            for (size_t i = 1; i < thread_count; ++i) {
+                const auto newline = source.find('\n', std::max(cuts.back(), source.size() / thread_count * i));
+                if (newline == std::string::npos) break;
+                if (newline + 1 > cuts.back()) cuts.push_back(newline + 1);
+            }
+            cuts.push_back(source.size());
+
+            const auto chunk_count = cuts.size() - 1;
+            std::vector<std::vector<Token>> chunks(chunk_count);
+            std::vector<int64_t> lines(chunk_count);
+            Location end{1, 0};
+            auto for_each_chunk = [chunk_count](auto&& function) {
+                std::vector<std::thread> threads;
+                for (size_t i = 1; i < chunk_count; ++i) {
+                    threads.emplace_back(function, i);
+                }
+                function(0);
+                for (auto& thread : threads) {
+                    thread.join();
+                }
+            };
+            for_each_chunk([&](size_t i) {
+                Lexer lexer{path, std::span<const char>{source.data() + cuts[i], cuts[i + 1] - cuts[i]}};
+                for (; lexer.current_token().type != tok_eof; lexer.next_token()) {
+                    chunks[i].push_back(std::move(lexer.m_current_token));
+                }
+                lines[i] = lexer.m_location.line - 1;
+                if (i == chunk_count - 1) end = lexer.m_location;
+            });
+
+            std::vector<size_t> offsets(chunk_count + 1, 0);
+            std::vector<int64_t> first_lines(chunk_count, 0);
+            for (size_t i = 0; i < chunk_count; ++i) {
+                offsets[i + 1] = offsets[i] + chunks[i].size();
+                if (i + 1 < chunk_count) first_lines[i + 1] = first_lines[i] + lines[i];
+            }
+            std::vector<Token> tokens(offsets.back());
+            for_each_chunk([&](size_t i) {
+                auto output = tokens.begin() + static_cast<int64_t>(offsets[i]);
+                for (auto& token : chunks[i]) {
+                    token.location.line += first_lines[i];
+                    *output++ = std::move(token);
+                }
+                std::vector<Token>{}.swap(chunks[i]);
+            });
+            tokens.push_back({tok_eof, "", 0, {end.line + first_lines.back(), end.column}});
+            return tokens;
+        }
+
     private:
         std::filesystem::path m_path;
         Location m_location;
-        std::ifstream m_ifstream;
+        std::unique_ptr<std::istream> m_stream;
+        std::vector<Token> m_tokens;
+        size_t m_next_token{0};
         Token m_current_token;
 
         Token interpret_next_token() {
@@ -127,7 +217,7 @@ namespace sorth {
                         return {tok_unexpected, "Invalid number", 0, location};
                     }
                 default:
-                    static_assert(lang::keyword_count == 8);
+                    static_assert(lang::keyword_count == 10);
                     static const std::unordered_map<std::string, lang::Keyword> keywords {
                             {"func", lang::keyword_function},
                             {"const", lang::keyword_const},
@@ -137,8 +227,10 @@ namespace sorth {
                             {"else", lang::keyword_else},
                             {"elif", lang::keyword_else_if},
                             {"while", lang::keyword_while},
+                            {"spawn", lang::keyword_spawn},
+                            {"join", lang::keyword_join},
                     };
-                    static_assert(lang::intrinsic_count == 15);
+                    static_assert(lang::intrinsic_count == 24);
                     static const std::unordered_map<std::string, lang::Intrinsic> intrinsics {
                             {"+", lang::intrinsic_add},
                             {"-", lang::intrinsic_sub},
@@ -156,6 +248,17 @@ namespace sorth {
                             {"=", lang::intrinsic_equal},
                             {"<", lang::intrinsic_less},
                             {">", lang::intrinsic_greater},
+
+                            {"len", lang::intrinsic_str_len},
+                            {"cmp", lang::intrinsic_str_compare},
+                            {"slice", lang::intrinsic_str_slice},
+
+                            {"alloc", lang::intrinsic_buf_alloc},
+                            {"fill", lang::intrinsic_buf_fill},
+                            {"copy", lang::intrinsic_buf_copy},
+                            {"sum", lang::intrinsic_buf_sum},
+                            {"min", lang::intrinsic_buf_min},
+                            {"max", lang::intrinsic_buf_max},
                     };
                     if (keywords.contains(word)) {
                         return {tok_keyword, word, keywords.at(word), location};
@@ -171,7 +274,7 @@ namespace sorth {
             std::stringstream word;
             char var = 0;
             do {
-                if (!m_ifstream.get(var)) return {false, "", m_location};
+                if (!m_stream->get(var)) return {false, "", m_location};
                 ++m_location.column;
                 if (var == '\n') {
                     m_location.column = 0;
@@ -182,7 +285,7 @@ namespace sorth {
             bool is_str = var == '\"';
             do {
                 word << var;
-                if (!m_ifstream.get(var)) return {true, word.str(), loc};
+                if (!m_stream->get(var)) return {true, word.str(), loc};
                 ++m_location.column;
                 if (var == '\n') {
                     m_location.column = 0;
@@ -4,6 +4,9 @@
 #include <sstream>
 #include <memory>
 #include <iostream>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
 #include "parser.h"
 
 namespace sorth {
@@ -18,7 +21,6 @@ namespace sorth {
     static std::string err_message(const Args&... args) {
         std::stringstream out;
         (out << ... << args);
-        out << "\n";
         return out.str();
     }
 
@@ -49,41 +51,146 @@ namespace sorth {
         return std::equal(inner.out.begin(), inner.out.end(), outer.out.begin() + offset);
     }
 
+    static int64_t add_string_literal(ast::Program& program, const std::string& value) {
+        if (auto it = program.string_ids.find(value); it != program.string_ids.end()) return it->second;
+        auto id = static_cast<int64_t>(program.strings.size());
+        program.strings.push_back({static_cast<int64_t>(program.data.size()), static_cast<int64_t>(value.size())});
+        program.data += value;
+        program.string_ids.emplace(value, id);
+        return id;
+    }
+
+    static std::unique_ptr<ast::OperationExpression> make_intrinsic_operation(lang::Intrinsic intrinsic, const type::TypeSignature& signature) {
+        const auto operation = lang::intrinsic_to_operation(intrinsic);
+        switch (operation) {
+            case lang::op_add:
+            case lang::op_mul:
+                if (signature.in.front() == type::buf_t)
+                    return std::make_unique<ast::OperationExpression>(operation == lang::op_add ? lang::op_buf_add : lang::op_buf_mul);
+                return std::make_unique<ast::OperationExpression>(operation);
+            case lang::op_drop:
+            case lang::op_dup:
+                return std::make_unique<ast::IntOperationExpression>(operation, type::get_slot_count(signature.in));
+            case lang::op_swap:
+                return std::make_unique<ast::IntOperationExpression>(operation, lang::pack_slot_counts(type::get_slot_count(signature.in.front()), type::get_slot_count(signature.in.back())));
+            default:
+                return std::make_unique<ast::OperationExpression>(operation);
+        }
+    }
+
+    static type::TypeSignature compose_signature(const type::TypeSignature& first, const type::TypeSignature& second) {
+        // signature of applying first and then second
+        type::TypeSignature composed{first};
+        auto missing = static_cast<int64_t>(second.in.size()) - static_cast<int64_t>(first.out.size());
+        if (missing > 0) {
+            composed.in.insert(composed.in.begin(), second.in.begin(), second.in.begin() + missing);
+            composed.out.clear();
+        } else {
+            composed.out.erase(composed.out.end() - static_cast<int64_t>(second.in.size()), composed.out.end());
+        }
+        composed.out.insert(composed.out.end(), second.out.begin(), second.out.end());
+        return composed;
+    }
+
+    static void pad_signature(type::TypeSignature& signature, const type::TypeStack& type_stack, int64_t depth) {
+        // extend the signature to consume depth elements, passing the additional ones through untouched
+        auto missing = depth - static_cast<int64_t>(signature.in.size());
+        if (missing <= 0) return;
+        auto first = type_stack.end() - depth;
+        signature.in.insert(signature.in.begin(), first, first + missing);
+        signature.out.insert(signature.out.begin(), first, first + missing);
+    }
+
     static ast::IfExpression parse_if(Lexer& lexer, ast::Program& program, type::TypeStack& type_stack) {
         assert(is_keyword(lexer.current_token(), lang::keyword_if));
+        const type::TypeStack initial_stack{type_stack};
+        const type::TypeSignature pop_bool{{type::bool_t}, {}};
         ast::IfExpression if_expr;
-        auto first_condition = parse_scope(lexer, program, type_stack, lang::keyword_begin);
-        if_expr.first_if.condition = std::move(first_condition);
-        // todo: remove and check bool on top of the stack
-        auto first_body = parse_scope(lexer, program, type_stack);
-        if_expr.first_if.body = std::move(first_body);
-        lexer.next_token(); // fix this
-        while (is_keyword(lexer.current_token(), lang::keyword_else_if)) {
-            //condition
-            auto elif_condition = parse_scope(lexer, program, type_stack, lang::keyword_begin);
-            auto elif_body = parse_scope(lexer, program, type_stack);
+        // effect of all conditions evaluated so far and of every possible branch
+        type::TypeSignature conditions{};
+        std::vector<type::TypeSignature> branches;
+
+        auto parse_branch = [&](ast::ConditionalBranch& branch) {
+            branch.condition = parse_scope(lexer, program, type_stack, lang::keyword_begin);
+            if (type_stack.empty() || type_stack.back() != type::bool_t)
+                throw ParseException{lexer, err_message("Condition has to leave a bool on the stack.")};
+            type_stack.pop_back();
+            conditions = compose_signature(conditions, compose_signature(branch.condition.signature, pop_bool));
+            type::TypeStack body_stack{type_stack};
+            branch.body = parse_scope(lexer, program, body_stack);
+            branches.push_back(compose_signature(conditions, branch.body.signature));
             lexer.next_token();
+        };
+
+        parse_branch(if_expr.first_if);
+        while (is_keyword(lexer.current_token(), lang::keyword_else_if)) {
+            parse_branch(if_expr.else_if.emplace_back());
         }
         if (is_keyword(lexer.current_token(), lang::keyword_else)) {
-            auto else_body = parse_scope(lexer, program, type_stack);
+            lexer.next_token();
+            if (!is_keyword(lexer.current_token(), lang::keyword_begin))
+                throw ParseException{lexer, err_message("Expected { after else.")};
+            type::TypeStack body_stack{type_stack};
+            if_expr.else_body = parse_scope(lexer, program, body_stack);
+            branches.push_back(compose_signature(conditions, if_expr.else_body.signature));
+            lexer.next_token();
+        } else {
+            branches.push_back(conditions);
+        }
+
+        int64_t depth = 0;
+        for (const auto& branch : branches) {
+            depth = std::max(depth, static_cast<int64_t>(branch.in.size()));
         }
+        for (auto& branch : branches) {
+            pad_signature(branch, initial_stack, depth);
+            if (branch.out != branches.front().out)
+                throw ParseException{lexer, err_message("Branches of if are not matching. Expected: ", type::output_signature(branches.front()), "but got: ", type::output_signature(branch))};
+        }
+        if_expr.signature = branches.front();
+        type_stack = initial_stack;
+        check_and_apply_signature(if_expr.signature, type_stack);
         return if_expr;
     };
 
     static ast::WhileExpression parse_while(Lexer& lexer, ast::Program& program, type::TypeStack& type_stack) {
-        throw ParseException{err_message(lexer, "While not supported yet.")};
+        throw ParseException{lexer, err_message("While not supported yet.")};
         return {};
     };
 
+    static ast::StringOperationExpression parse_task_operation(Lexer& lexer, ast::Program& program, type::TypeStack& type_stack, type::TypeSignature& applied_signature) {
+        const auto keyword = static_cast<lang::Keyword>(lexer.current_token().int_val);
+        assert(keyword == lang::keyword_spawn || keyword == lang::keyword_join);
+        lexer.next_token();
+        const auto token = lexer.current_token();
+        if (token.type != Lexer::tok_word || !program.functions.contains(token.str_val))
+            throw ParseException{lexer, err_message("Expected function name after spawn/join.")};
+        const auto& signature = program.functions[token.str_val].signature;
+        const auto task_type = type::make_task_type(signature.out);
+        if (keyword == lang::keyword_spawn) {
+            applied_signature = {signature.in, {task_type}};
+        } else {
+            applied_signature = {{task_type}, signature.out};
+        }
+        if (type_stack.size() < applied_signature.in.size())
+            throw ParseException{lexer, err_message("Not enough data on the stack.")};
+        if (keyword == lang::keyword_join && type_stack.back() != task_type)
+            throw ParseException{lexer, err_message("Joined task does not produce the outputs of ", token.str_val, ". Expected: ", type::to_name(task_type), " but got: ", type::to_name(type_stack.back()))};
+        if (!check_and_apply_signature(applied_signature, type_stack))
+            throw ParseException{lexer, err_message("Required types on stack aren't matching.")};
+        return {keyword == lang::keyword_spawn ? lang::op_spawn : lang::op_join, token.str_val};
+    }
+
     ast::Scope parse_scope(Lexer& lexer, ast::Program& program, type::TypeStack& type_stack, const lang::Keyword end_keyword) {
         ast::Scope scope;
         int64_t local_offset = 0;
         lexer.next_token();
         while (!is_keyword(lexer.current_token(), end_keyword)) {
             const auto token = lexer.current_token();
+            const auto expression_count = scope.expressions.size();
             switch (token.type) {
                 case Lexer::tok_eof:
-                    throw ParseException{err_message(lexer, "Unexpected end of file. Scope is left unclosed.")};
+                    throw ParseException{lexer, err_message("Unexpected end of file. Scope is left unclosed.")};
                 case Lexer::tok_int:
                     scope.expressions.emplace_back(std::make_unique<ast::IntOperationExpression>(lang::op_push_int, token.int_val));
                     type_stack.push_back(type::int_t);
@@ -93,13 +200,13 @@ namespace sorth {
                     if (program.functions.contains(token.str_val)) {
                         const auto& signature = program.functions[token.str_val].signature;
                         if (type_stack.size() < signature.in.size())
-                            throw ParseException{err_message(lexer, "Not enough data on the stack.")};
+                            throw ParseException{lexer, err_message("Not enough data on the stack.")};
                         if (!check_and_apply_signature(signature, type_stack))
-                            throw ParseException{err_message(lexer, "Required types on stack aren't matching.")};
+                            throw ParseException{lexer, err_message("Required types on stack aren't matching.")};
                         recalibrate_offset(local_offset, signature, scope.signature);
                         scope.expressions.emplace_back(std::make_unique<ast::StringOperationExpression>(lang::op_call, token.str_val));
                     } else {
-                        throw ParseException{err_message(lexer, "Unknown word: ", token.str_val)};
+                        throw ParseException{lexer, err_message("Unknown word: ", token.str_val)};
                     }
                     break;
                 case Lexer::tok_keyword:
@@ -107,7 +214,7 @@ namespace sorth {
                     auto keyword = static_cast<lang::Keyword>(token.int_val);
                     switch (keyword) {
                         case lang::keyword_const:
-                            throw ParseException{err_message(lexer, "Const not implemented yet")};
+                            throw ParseException{lexer, err_message("Const not implemented yet")};
                             break;
                         case lang::keyword_begin:
                         {
@@ -117,13 +224,14 @@ namespace sorth {
                         }
                             break;
                         case lang::keyword_end:
-                            throw ParseException{err_message(lexer, "Unexpected end of scope.")};
+                            throw ParseException{lexer, err_message("Unexpected end of scope.")};
                             break;
                         case lang::keyword_if:
                         {
                             auto parsed_if = parse_if(lexer, program, type_stack);
                             recalibrate_offset(local_offset, parsed_if.signature, scope.signature);
                             scope.expressions.emplace_back(std::make_unique<ast::IfExpression>(std::move(parsed_if)));
+                            scope.expressions.back()->location = token.location;
                             continue; // skipping next token, cause if needs prefetching
                         }
                             break;
@@ -134,14 +242,23 @@ namespace sorth {
                             scope.expressions.emplace_back(std::make_unique<ast::WhileExpression>(std::move(parsed_while)));
                         }
                             break;
+                        case lang::keyword_spawn:
+                        case lang::keyword_join:
+                        {
+                            type::TypeSignature signature;
+                            auto operation = parse_task_operation(lexer, program, type_stack, signature);
+                            recalibrate_offset(local_offset, signature, scope.signature);
+                            scope.expressions.emplace_back(std::make_unique<ast::StringOperationExpression>(std::move(operation)));
+                        }
+                            break;
                         case lang::keyword_else:
-                            throw ParseException{err_message(lexer, "Unexpected else.")};
+                            throw ParseException{lexer, err_message("Unexpected else.")};
                             break;
                         case lang::keyword_else_if:
-                            throw ParseException{err_message(lexer, "Unexpected else if.")};
+                            throw ParseException{lexer, err_message("Unexpected else if.")};
                             break;
                         case lang::keyword_function:
-                            throw ParseException{err_message(lexer, "Functions are only allowed at toplevel.")};
+                            throw ParseException{lexer, err_message("Functions are only allowed at toplevel.")};
                             break;
                     }
                 }
@@ -150,18 +267,20 @@ namespace sorth {
                 {
                     auto intrinsic = static_cast<lang::Intrinsic>(token.int_val);
                     if (intrinsic == lang::intrinsic_invalid)
-                        throw ParseException{err_message(lexer, "Unknown Intrinsic.")};
+                        throw ParseException{lexer, err_message("Unknown Intrinsic.")};
                     if (type_stack.size() < lang::get_intrinsic_input_count(intrinsic))
-                        throw ParseException{err_message(lexer, "Not enough data on the stack.")};
+                        throw ParseException{lexer, err_message("Not enough data on the stack.")};
                     auto signature = lang::get_intrinsic_signature(intrinsic, type_stack);
                     if (!check_and_apply_signature(signature, type_stack))
-                        throw ParseException{err_message(lexer, "Required types on stack aren't matching.")};
+                        throw ParseException{lexer, err_message("Required types on stack aren't matching.")};
                     recalibrate_offset(local_offset, signature, scope.signature);
-                    scope.expressions.emplace_back(std::make_unique<ast::OperationExpression>(lang::intrinsic_to_operation(intrinsic)));
+                    scope.expressions.emplace_back(make_intrinsic_operation(intrinsic, signature));
                 }
                     break;
                 case Lexer::tok_str:
-                    throw ParseException{err_message(lexer, "Strings are not implemented yet.")};
+                    scope.expressions.emplace_back(std::make_unique<ast::IntOperationExpression>(lang::op_push_str, add_string_literal(program, token.str_val)));
+                    type_stack.push_back(type::str_t);
+                    ++local_offset;
                     break;
                 case Lexer::tok_char:
                     scope.expressions.emplace_back(std::make_unique<ast::IntOperationExpression>(lang::op_push_int, token.int_val));
@@ -169,57 +288,64 @@ namespace sorth {
                     ++local_offset;
                     break;
                 case Lexer::tok_unexpected:
-                    throw ParseException{err_message(lexer, "Unexpected token.")};
+                    throw ParseException{lexer, err_message("Unexpected token.")};
             }
+            if (scope.expressions.size() > expression_count) scope.expressions.back()->location = token.location;
             lexer.next_token();
         }
         scope.signature.out.insert(scope.signature.out.begin(), type_stack.end() - local_offset, type_stack.end());
         return scope;
     }
 
-    static ast::Function parse_function(Lexer& lexer, ast::Program& program) {
+    ast::Function parse_function_signature(Lexer& lexer, const ast::Program& program) {
         assert(is_keyword(lexer.current_token(), lang::keyword_function));
+        const auto location = lexer.current_token().location;
         // read name
         lexer.next_token();
-        if (lexer.current_token().type != Lexer::tok_word) throw ParseException{err_message(lexer, "Expected word as function name")};
+        if (lexer.current_token().type != Lexer::tok_word) throw ParseException{lexer, err_message("Expected word as function name")};
         auto name = lexer.current_token().str_val;
         // todo: restrict function name further
         if (program.functions.contains(name))
-            throw ParseException{err_message(lexer, "Redefinition of function: ", name)};
+            throw ParseException{lexer, err_message("Redefinition of function: ", name)};
         // read signature
         type::TypeSignature signature;
         lexer.next_token();
         // read input types
         for (; !is_keyword(lexer.current_token(), lang::keyword_begin); lexer.next_token()) {
             const auto token = lexer.current_token();
-            if (token.type != Lexer::tok_word) throw ParseException{err_message(lexer, "Expected word in function signature")};
+            if (token.type != Lexer::tok_word) throw ParseException{lexer, err_message("Expected word in function signature")};
             if (token.str_val == "--") {
                 lexer.next_token();
                 break;
             }
             auto type = type::from_name(token.str_val);
-            if (type == type::invalid_t) throw ParseException{err_message(lexer, "Unknown type ", token.str_val)};
+            if (type == type::invalid_t) throw ParseException{lexer, err_message("Unknown type ", token.str_val)};
             signature.in.push_back(type);
         }
         for (; !is_keyword(lexer.current_token(), lang::keyword_begin); lexer.next_token()) {
             const auto token = lexer.current_token();
-            if (token.type != Lexer::tok_word) throw ParseException{err_message(lexer, "Expected word in function signature")};
+            if (token.type != Lexer::tok_word) throw ParseException{lexer, err_message("Expected word in function signature")};
             auto type = type::from_name(token.str_val);
-            if (type == type::invalid_t) throw ParseException{err_message(lexer, "Unknown type ", token.str_val)};
+            if (type == type::invalid_t) throw ParseException{lexer, err_message("Unknown type ", token.str_val)};
             signature.out.push_back(type);
         }
+        return {name, signature, {}, location};
+    }
 
-        type::TypeStack type_stack{signature.in};
-        auto scope = parse_scope(lexer, program, type_stack);
-        if (!match_signature(signature, scope.signature))
-            throw ParseException{err_message(lexer, "Function signature does not match. Expected: ", type::output_signature(signature), "but got: ", type::output_signature(scope.signature))};
-        return {name, signature, std::move(scope)};
+    ast::Function parse_function(Lexer& lexer, ast::Program& program) {
+        auto function = parse_function_signature(lexer, program);
+        // register the signature up front, so the body can call the function recursively
+        program.functions[function.name] = {function.name, function.signature, {}, function.location};
+        type::TypeStack type_stack{function.signature.in};
+        function.body = parse_scope(lexer, program, type_stack);
+        if (!match_signature(function.signature, function.body.signature))
+            throw ParseException{lexer, err_message("Function signature does not match. Expected: ", type::output_signature(function.signature), "but got: ", type::output_signature(function.body.signature))};
+        return function;
     }
 
-    ast::Program parse_program(const std::filesystem::path& path) {
+    static ast::Program parse_program(Lexer& lexer, const std::filesystem::path& path) {
         ast::Program program;
-
-        Lexer lexer{path};
+        program.path = path;
 
         for (; lexer.current_token().type != Lexer::tok_eof; lexer.next_token()) {
             const auto token = lexer.current_token();
@@ -227,19 +353,36 @@ namespace sorth {
                 case Lexer::tok_keyword:
                     if (token.int_val == lang::keyword_function) {
                         auto function = parse_function(lexer, program);
-                        program.functions.insert(std::make_pair(function.name, std::move(function)));
+                        program.functions[function.name] = std::move(function);
                     } else {
                         // todo: add detail
-                        throw ParseException{err_message(lexer, "Unexpected keyword: ", token.str_val)};
+                        throw ParseException{lexer, err_message("Unexpected keyword: ", token.str_val)};
                     }
                     break;
                 default:
                     // todo: add detail
-                    throw ParseException{err_message(lexer, "Unexpected token")};
+                    throw ParseException{lexer, err_message("Unexpected token")};
                     break;
             }
         }
 
         return program;
     }
-}
\ No newline at end of file
+
+    ast::Program parse_program(const std::filesystem::path& path) {
+        Lexer lexer{path};
+        return parse_program(lexer, path);
+    }
+
+    ast::Program parse_program(const std::filesystem::path& path, std::string source) {
+        Lexer lexer{path, std::move(source)};
+        return parse_program(lexer, path);
+    }
+
+    ast::Program parse_program_parallel(const std::filesystem::path& path, size_t lex_threads) {
+        std::ifstream file{path, std::ios::binary};
+        const std::string source{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+        Lexer lexer{path, Lexer::tokenize_parallel(path, source, lex_threads)};
+        return parse_program(lexer, path);
+    }
+}
@@ -6,6 +6,7 @@
 
 #include <filesystem>
 #include <exception>
+#include <sstream>
 #include "ast.h"
 #include "lexer.h"
 #include "type.h"
@@ -14,7 +15,29 @@ namespace sorth {
 
     ast::Program parse_program(const std::filesystem::path& path);
 
+    ast::Program parse_program(const std::filesystem::path& path, std::string source);
+
+    // Tokenizes the file on lex_threads threads before parsing, for very large sources
+    ast::Program parse_program_parallel(const std::filesystem::path& path, size_t lex_threads);
+
+    // Parses the definition starting at the current func keyword, program holds the functions it can call
+    ast::Function parse_function(Lexer& lexer, ast::Program& program);
+
+    // Parses only name and signature, leaving the lexer at the { of the body
+    ast::Function parse_function_signature(Lexer& lexer, const ast::Program& program);
+
     struct ParseException : public std::runtime_error {
-        explicit ParseException(const std::string& message) : std::runtime_error(message) {}
+        ParseException(const Lexer& lexer, const std::string& reason)
+            : std::runtime_error(format(lexer, reason)), location(lexer.current_token().location), reason(reason) {}
+
+        Lexer::Location location;
+        std::string reason;
+
+    private:
+        static std::string format(const Lexer& lexer, const std::string& reason) {
+            std::stringstream out;
+            out << lexer << reason << '\n';
+            return out.str();
+        }
     };
 }
\ No newline at end of file
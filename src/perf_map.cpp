@@ -0,0 +1,85 @@
+#include <cstring>
+#include <stdexcept>
+
+#include "perf_map.h"
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+namespace sorth::runtime {
+
+    PerfMap::PerfMap() {
+#if defined(__linux__)
+        const auto path = "/tmp/perf-" + std::to_string(getpid()) + ".map";
+        m_file = std::fopen(path.c_str(), "w");
+#else
+        m_file = nullptr;
+#endif
+    }
+
+    PerfMap::~PerfMap() {
+        if (m_file) std::fclose(m_file);
+    }
+
+    void PerfMap::add(const void* start, size_t size, const std::string& name) {
+        if (!m_file) return;
+        std::lock_guard lock{m_mutex};
+        std::fprintf(m_file, "%zx %zx %s\n", reinterpret_cast<size_t>(start), size, name.c_str());
+        std::fflush(m_file);
+    }
+
+    ExecutableMemory::~ExecutableMemory() {
+#if defined(__linux__)
+        for (auto [address, size] : m_mappings) {
+            munmap(address, size);
+        }
+#endif
+    }
+
+    const uint8_t* ExecutableMemory::map(const std::vector<uint8_t>& code) {
+#if defined(__linux__)
+        auto address = mmap(nullptr, code.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (address == MAP_FAILED) throw std::runtime_error{"Failed to map executable memory."};
+        std::memcpy(address, code.data(), code.size());
+        if (mprotect(address, code.size(), PROT_READ | PROT_EXEC) != 0) {
+            munmap(address, code.size());
+            throw std::runtime_error{"Failed to map executable memory."};
+        }
+        std::lock_guard lock{m_mutex};
+        m_mappings.emplace_back(address, code.size());
+        return static_cast<const uint8_t*>(address);
+#else
+        throw std::runtime_error{"Executable memory is not supported on this platform."};
+#endif
+    }
+
+    std::vector<Trampoline> make_trampolines(ExecutableMemory& memory, PerfMap& perf_map, const std::vector<std::string>& names) {
+        if (!trampolines_supported || names.empty()) return {};
+        // push rbp; mov rbp, rsp; call rsi; pop rbp; ret -- padded to 16 bytes. The frame keeps
+        // the chain of frame pointers intact for perf record -g
+        static constexpr uint8_t trampoline[] = {
+                0x55,
+                0x48, 0x89, 0xe5,
+                0xff, 0xd6,
+                0x5d,
+                0xc3,
+                0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc,
+        };
+        static constexpr size_t trampoline_size = sizeof(trampoline);
+        std::vector<uint8_t> code;
+        code.reserve(names.size() * trampoline_size);
+        for (size_t i = 0; i < names.size(); ++i) {
+            code.insert(code.end(), std::begin(trampoline), std::end(trampoline));
+        }
+        const auto start = memory.map(code);
+        std::vector<Trampoline> trampolines;
+        for (size_t i = 0; i < names.size(); ++i) {
+            const auto address = start + i * trampoline_size;
+            perf_map.add(address, trampoline_size, names[i]);
+            trampolines.push_back(reinterpret_cast<Trampoline>(const_cast<uint8_t*>(address)));
+        }
+        return trampolines;
+    }
+}
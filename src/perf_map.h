@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <mutex>
+
+namespace sorth::runtime {
+
+    // Writes /tmp/perf-<pid>.map, which perf uses to symbolise addresses outside of any loaded binary.
+    // Samples are attributed per function and tier only, neither tier runs native code of its own
+    // that source lines could be mapped to. Samples land in the interpreter, the trampolines only
+    // show up in call chains: record with perf record -g, which needs the frame pointers the build
+    // keeps with -fno-omit-frame-pointer.
+    class PerfMap {
+
+    public:
+
+        PerfMap();
+
+        PerfMap(const PerfMap&) = delete;
+
+        PerfMap& operator=(const PerfMap&) = delete;
+
+        ~PerfMap();
+
+        void add(const void* start, size_t size, const std::string& name);
+
+    private:
+        std::mutex m_mutex;
+        std::FILE* m_file;
+    };
+
+    // Executable copies of small code snippets, never freed before the owner is destroyed
+    class ExecutableMemory {
+
+    public:
+
+        ExecutableMemory() = default;
+
+        ExecutableMemory(const ExecutableMemory&) = delete;
+
+        ExecutableMemory& operator=(const ExecutableMemory&) = delete;
+
+        ~ExecutableMemory();
+
+        const uint8_t* map(const std::vector<uint8_t>& code);
+
+    private:
+        std::mutex m_mutex;
+        std::vector<std::pair<void*, size_t>> m_mappings;
+    };
+
+    // Calls target(frame) through a tiny piece of generated code, which shows up as its own frame
+    // in native stack traces. Target must not throw, there is no unwind info for the trampoline.
+    using TrampolineTarget = void (*)(void* frame);
+    using Trampoline = void (*)(void* frame, TrampolineTarget target);
+
+    static constexpr bool trampolines_supported =
+#if defined(__linux__) && defined(__x86_64__)
+            true;
+#else
+            false;
+#endif
+
+    // Creates one trampoline per name and registers each of them in the perf map
+    std::vector<Trampoline> make_trampolines(ExecutableMemory& memory, PerfMap& perf_map, const std::vector<std::string>& names);
+}
@@ -0,0 +1,90 @@
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include "profile.h"
+
+namespace sorth::profile {
+
+    // File format, one record per line:
+    //   function <name> <calls>
+    //   call <function> <line> <column> <calls>
+    //   branch <function> <line> <column> <taken>...
+
+    std::string Profile::site(const std::string& function, const Lexer::Location& location) {
+        return function + ' ' + std::to_string(location.line) + ' ' + std::to_string(location.column);
+    }
+
+    int64_t Profile::call_site_count(const std::string& function, const Lexer::Location& location) const {
+        auto it = call_sites.find(site(function, location));
+        return it == call_sites.end() ? 0 : it->second;
+    }
+
+    const std::vector<int64_t>* Profile::branch_counts(const std::string& function, const Lexer::Location& location) const {
+        auto it = branches.find(site(function, location));
+        return it == branches.end() ? nullptr : &it->second;
+    }
+
+    std::vector<std::string> Profile::hot_functions() const {
+        std::vector<std::pair<std::string, int64_t>> sorted{functions.begin(), functions.end()};
+        std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+            return a.second != b.second ? a.second > b.second : a.first < b.first;
+        });
+        std::vector<std::string> names;
+        for (const auto& [name, calls] : sorted) {
+            if (calls > 0) names.push_back(name);
+        }
+        return names;
+    }
+
+    Profile load(const std::filesystem::path& path) {
+        std::ifstream file{path};
+        if (!file) throw ProfileException{"Failed to open profile " + path.string()};
+        Profile profile;
+        std::string line;
+        for (int64_t line_number = 1; std::getline(file, line); ++line_number) {
+            std::istringstream record{line};
+            std::string kind, function;
+            if (!(record >> kind >> function)) continue;
+            if (kind == "function") {
+                int64_t calls;
+                if (!(record >> calls)) throw ProfileException{"Malformed profile record in line " + std::to_string(line_number)};
+                profile.functions[function] = calls;
+                continue;
+            }
+            Lexer::Location location{};
+            if (!(record >> location.line >> location.column))
+                throw ProfileException{"Malformed profile record in line " + std::to_string(line_number)};
+            std::vector<int64_t> counts;
+            for (int64_t count; record >> count;) {
+                counts.push_back(count);
+            }
+            if (kind == "call" && counts.size() == 1) {
+                profile.call_sites[Profile::site(function, location)] = counts.front();
+            } else if (kind == "branch" && !counts.empty()) {
+                profile.branches[Profile::site(function, location)] = std::move(counts);
+            } else {
+                throw ProfileException{"Malformed profile record in line " + std::to_string(line_number)};
+            }
+        }
+        return profile;
+    }
+
+    void save(const Profile& profile, const std::filesystem::path& path) {
+        std::ofstream file{path};
+        if (!file) throw ProfileException{"Failed to write profile " + path.string()};
+        for (const auto& [function, calls] : profile.functions) {
+            file << "function " << function << ' ' << calls << '\n';
+        }
+        for (const auto& [site, calls] : profile.call_sites) {
+            file << "call " << site << ' ' << calls << '\n';
+        }
+        for (const auto& [site, counts] : profile.branches) {
+            file << "branch " << site;
+            for (const auto& count : counts) {
+                file << ' ' << count;
+            }
+            file << '\n';
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <filesystem>
+#include <unordered_map>
+
+#include "lexer.h"
+
+namespace sorth::profile {
+
+    // Execution counts recorded by an instrumented run. Sites are identified by the
+    // function containing them and their source location, so a profile survives
+    // recompilation as long as the source doesn't change.
+    struct Profile {
+        // function -> number of calls
+        std::unordered_map<std::string, int64_t> functions;
+        // call site -> number of calls
+        std::unordered_map<std::string, int64_t> call_sites;
+        // if -> how often each branch was taken, the last entry counts the else or no branch at all
+        std::unordered_map<std::string, std::vector<int64_t>> branches;
+
+        static std::string site(const std::string& function, const Lexer::Location& location);
+
+        int64_t call_site_count(const std::string& function, const Lexer::Location& location) const;
+
+        const std::vector<int64_t>* branch_counts(const std::string& function, const Lexer::Location& location) const;
+
+        // profiled functions, hottest first
+        std::vector<std::string> hot_functions() const;
+    };
+
+    Profile load(const std::filesystem::path& path);
+
+    void save(const Profile& profile, const std::filesystem::path& path);
+
+    struct ProfileException : public std::runtime_error {
+        explicit ProfileException(const std::string& message) : std::runtime_error(message) {}
+    };
+}
@@ -0,0 +1,145 @@
+#include "runtime.h"
+
+namespace sorth::runtime {
+
+    static thread_local const Scheduler* current_scheduler = nullptr;
+    static thread_local size_t current_worker = 0;
+
+    DataStack StackPool::acquire() {
+        {
+            std::lock_guard lock{m_mutex};
+            if (!m_free.empty()) {
+                auto stack = std::move(m_free.back());
+                m_free.pop_back();
+                return stack;
+            }
+        }
+        DataStack stack;
+        stack.reserve(m_reserved_size);
+        return stack;
+    }
+
+    void StackPool::release(DataStack&& stack) {
+        stack.clear();
+        std::lock_guard lock{m_mutex};
+        m_free.push_back(std::move(stack));
+    }
+
+    value_t* Arena::allocate(size_t size) {
+        std::lock_guard lock{m_mutex};
+        if (size > m_block_size / 4) {
+            // large buffers get their own block, so they don't waste the current one
+            return m_large_blocks.emplace_back(std::make_unique_for_overwrite<value_t[]>(size)).get();
+        }
+        if (m_blocks.empty() || m_block_used + size > m_block_size) {
+            m_blocks.emplace_back(std::make_unique_for_overwrite<value_t[]>(m_block_size));
+            m_block_used = 0;
+        }
+        auto data = m_blocks.back().get() + m_block_used;
+        m_block_used += size;
+        return data;
+    }
+
+    Scheduler::Scheduler(size_t worker_count) {
+        for (size_t i = 0; i <= worker_count; ++i) {
+            m_queues.emplace_back(std::make_unique<Queue>());
+        }
+        for (size_t i = 0; i < worker_count; ++i) {
+            m_workers.emplace_back(&Scheduler::work, this, i);
+        }
+    }
+
+    Scheduler::~Scheduler() {
+        {
+            std::lock_guard lock{m_idle_mutex};
+            m_stop = true;
+        }
+        m_idle.notify_all();
+        for (auto& worker : m_workers) {
+            worker.join();
+        }
+    }
+
+    size_t Scheduler::own_queue() const {
+        return current_scheduler == this ? current_worker : m_workers.size();
+    }
+
+    void Scheduler::submit(Task& task) {
+        auto& queue = *m_queues[own_queue()];
+        {
+            std::lock_guard lock{queue.mutex};
+            queue.tasks.push_back(&task);
+        }
+        ++m_queued;
+        // synchronise with workers about to fall asleep, so the notification is not lost
+        { std::lock_guard lock{m_idle_mutex}; }
+        m_idle.notify_one();
+        notify_joiners();
+    }
+
+    void Scheduler::join(Task& task) {
+        const auto index = own_queue();
+        while (!task.done.load()) {
+            if (run_one(index)) continue;
+            std::unique_lock lock{m_idle_mutex};
+            ++m_sleeping_joiners;
+            m_progress.wait(lock, [this, &task]() { return task.done.load() || m_queued > 0; });
+            --m_sleeping_joiners;
+        }
+        if (task.exception) std::rethrow_exception(task.exception);
+    }
+
+    void Scheduler::notify_joiners() {
+        // joiners register before they check for progress, so either they see it or they get woken up
+        if (m_sleeping_joiners.load() == 0) return;
+        { std::lock_guard lock{m_idle_mutex}; }
+        m_progress.notify_all();
+    }
+
+    Task* Scheduler::pop(size_t index) {
+        auto& queue = *m_queues[index];
+        std::lock_guard lock{queue.mutex};
+        if (queue.tasks.empty()) return nullptr;
+        auto task = queue.tasks.back();
+        queue.tasks.pop_back();
+        return task;
+    }
+
+    Task* Scheduler::steal(size_t thief) {
+        const auto count = m_queues.size();
+        for (size_t offset = 1; offset < count; ++offset) {
+            auto& queue = *m_queues[(thief + offset) % count];
+            std::lock_guard lock{queue.mutex};
+            if (queue.tasks.empty()) continue;
+            auto task = queue.tasks.front();
+            queue.tasks.pop_front();
+            return task;
+        }
+        return nullptr;
+    }
+
+    bool Scheduler::run_one(size_t index) {
+        auto task = pop(index);
+        if (task == nullptr) task = steal(index);
+        if (task == nullptr) return false;
+        --m_queued;
+        try {
+            task->body(task->stack);
+        } catch (...) {
+            task->exception = std::current_exception();
+        }
+        task->done.store(true);
+        notify_joiners();
+        return true;
+    }
+
+    void Scheduler::work(size_t index) {
+        current_scheduler = this;
+        current_worker = index;
+        while (!m_stop) {
+            if (run_one(index)) continue;
+            std::unique_lock lock{m_idle_mutex};
+            m_idle.wait(lock, [this]() { return m_stop || m_queued > 0; });
+        }
+    }
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <condition_variable>
+
+namespace sorth::runtime {
+
+    using value_t = int64_t;
+
+    using DataStack = std::vector<value_t>;
+
+    // Recycles data stacks, so spawning a task does not have to allocate a fresh one
+    class StackPool {
+
+    public:
+
+        explicit StackPool(size_t reserved_size = 256) : m_reserved_size(reserved_size) {}
+
+        DataStack acquire();
+
+        void release(DataStack&& stack);
+
+    private:
+        size_t m_reserved_size;
+        std::mutex m_mutex;
+        std::vector<DataStack> m_free;
+    };
+
+    // Owns every buffer allocated by a program, memory is released when the arena is destroyed
+    class Arena {
+
+    public:
+
+        explicit Arena(size_t block_size = 1 << 16) : m_block_size(block_size) {}
+
+        value_t* allocate(size_t size);
+
+    private:
+        size_t m_block_size;
+        size_t m_block_used{0};
+        std::mutex m_mutex;
+        std::vector<std::unique_ptr<value_t[]>> m_blocks;
+        std::vector<std::unique_ptr<value_t[]>> m_large_blocks;
+    };
+
+    struct Task {
+        std::function<void(DataStack&)> body;
+        DataStack stack;
+        std::exception_ptr exception{};
+        std::atomic<bool> done{false};
+    };
+
+    // Work-stealing thread pool: every worker owns a deque, pushes and pops at its back
+    // and steals from the front of the others when it runs out of work.
+    class Scheduler {
+
+    public:
+
+        explicit Scheduler(size_t worker_count = std::max(1u, std::thread::hardware_concurrency()));
+
+        Scheduler(const Scheduler&) = delete;
+
+        Scheduler& operator=(const Scheduler&) = delete;
+
+        ~Scheduler();
+
+        void submit(Task& task);
+
+        // Blocks until the task is done, running other tasks in the meantime
+        void join(Task& task);
+
+    private:
+        struct Queue {
+            std::mutex mutex;
+            std::deque<Task*> tasks;
+        };
+
+        // one queue per worker and a shared one for threads outside the pool
+        std::vector<std::unique_ptr<Queue>> m_queues;
+        std::vector<std::thread> m_workers;
+        std::atomic<bool> m_stop{false};
+        std::atomic<int64_t> m_queued{0};
+        std::mutex m_idle_mutex;
+        std::condition_variable m_idle;
+        // joining threads with nothing left to run sleep until a task finishes or new work arrives
+        std::condition_variable m_progress;
+        std::atomic<int64_t> m_sleeping_joiners{0};
+
+        void notify_joiners();
+
+        size_t own_queue() const;
+
+        Task* pop(size_t index);
+
+        Task* steal(size_t thief);
+
+        bool run_one(size_t index);
+
+        void work(size_t index);
+    };
+}
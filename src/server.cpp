@@ -0,0 +1,250 @@
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "server.h"
+#include "parser.h"
+
+#if defined(__unix__)
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#endif
+
+namespace sorth::server {
+
+    // Protocol: the client sends "<check|compile|shutdown> <absolute path>\n",
+    // the server answers "ok\n" or "error\n" followed by the message and closes the connection.
+
+    static const char* request_names[] = {"check", "compile", "shutdown"};
+
+    static std::optional<RequestType> parse_request_type(const std::string& name) {
+        for (size_t i = 0; i < std::size(request_names); ++i) {
+            if (name == request_names[i]) return static_cast<RequestType>(i);
+        }
+        return std::nullopt;
+    }
+
+    std::filesystem::path default_socket_path() {
+#if defined(__unix__)
+        return std::filesystem::temp_directory_path() / ("sorth-" + std::to_string(getuid()) + ".sock");
+#else
+        return std::filesystem::temp_directory_path() / "sorth.sock";
+#endif
+    }
+
+    std::shared_ptr<CompileServer::Entry> CompileServer::lookup(const std::filesystem::path& path) {
+        const auto key = path.string();
+        const auto modified = std::filesystem::last_write_time(path);
+        std::shared_ptr<Entry> cached;
+        {
+            std::lock_guard lock{m_mutex};
+            if (auto it = m_entries.find(key); it != m_entries.end()) cached = it->second;
+            if (cached && cached->modified == modified) return cached;
+        }
+
+        std::ifstream file{path, std::ios::binary};
+        std::string source{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+        const auto hash = std::hash<std::string>{}(source);
+        if (cached && cached->hash == hash) {
+            // touched, but unchanged
+            std::lock_guard lock{m_mutex};
+            cached->modified = modified;
+            return cached;
+        }
+
+        auto entry = std::make_shared<Entry>();
+        entry->modified = modified;
+        entry->hash = hash;
+        try {
+            entry->program = std::make_shared<const ast::Program>(parse_program(path, std::move(source)));
+        } catch (const ParseException& ex) {
+            entry->error = ex.what();
+        }
+        std::lock_guard lock{m_mutex};
+        m_entries.insert_or_assign(key, entry);
+        return entry;
+    }
+
+    void CompileServer::compile(Entry& entry) {
+        if (entry.error || entry.code) return;
+        std::unordered_map<std::string, int64_t> ids;
+        for (const auto& [name, function] : entry.program->functions) {
+            ids.emplace(name, static_cast<int64_t>(ids.size()));
+        }
+        const auto resolve = [&ids](const std::string& name) { return ids.at(name); };
+        try {
+            std::vector<compiler::Code> code;
+            for (const auto& [name, function] : entry.program->functions) {
+                code.push_back(compiler::compile(*entry.program, function, resolve));
+            }
+            entry.code = std::move(code);
+        } catch (const compiler::CompileException& ex) {
+            entry.error = ex.what();
+        }
+    }
+
+    Response CompileServer::handle(RequestType type, const std::filesystem::path& path) {
+        if (!std::filesystem::exists(path)) return {false, "No such file: " + path.string()};
+        const auto shared_entry = lookup(path);
+        auto& entry = *shared_entry;
+        std::lock_guard lock{entry.mutex};
+        if (type == request_compile) compile(entry);
+        if (entry.error) return {false, *entry.error};
+        std::stringstream message;
+        message << entry.program->functions.size() << " functions";
+        if (type == request_compile) {
+            size_t instructions = 0;
+            for (const auto& code : *entry.code) {
+                instructions += code.instructions.size();
+            }
+            message << ", " << instructions << " instructions";
+        }
+        return {true, message.str()};
+    }
+
+    Response handle_locally(RequestType type, const std::filesystem::path& path) {
+        CompileServer server{{}};
+        try {
+            return server.handle(type, path);
+        } catch (const std::exception& ex) {
+            return {false, ex.what()};
+        }
+    }
+
+#if defined(__unix__)
+
+    static sockaddr_un make_address(const std::filesystem::path& socket_path) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        const auto native = socket_path.string();
+        if (native.size() >= sizeof(address.sun_path)) throw std::runtime_error{"Socket path too long: " + native};
+        native.copy(address.sun_path, native.size());
+        return address;
+    }
+
+    // requests are a single line, a client that never finishes it only stalls its own connection
+    static std::optional<std::string> read_line(int fd) {
+        static constexpr size_t max_line_size = 1 << 16;
+        const timeval timeout{5, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        std::string line;
+        char buffer[4096];
+        while (line.size() < max_line_size) {
+            const auto count = recv(fd, buffer, sizeof(buffer), 0);
+            if (count <= 0) return std::nullopt;
+            line.append(buffer, count);
+            if (const auto end = line.find('\n'); end != std::string::npos) {
+                line.resize(end);
+                return line;
+            }
+        }
+        return std::nullopt;
+    }
+
+    static std::string read_all(int fd) {
+        std::string data;
+        char buffer[4096];
+        ssize_t count;
+        while ((count = read(fd, buffer, sizeof(buffer))) > 0) {
+            data.append(buffer, count);
+        }
+        return data;
+    }
+
+    static void write_all(int fd, const std::string& data) {
+        size_t written = 0;
+        while (written < data.size()) {
+            // a client going away must not take the server down with SIGPIPE
+            auto count = send(fd, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+            if (count <= 0) return;
+            written += count;
+        }
+    }
+
+    void CompileServer::serve() {
+        const auto address = make_address(m_socket_path);
+        const int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (server_fd < 0) throw std::runtime_error{"Failed to create socket."};
+        std::filesystem::remove(m_socket_path);
+        if (bind(server_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(server_fd, 64) != 0) {
+            close(server_fd);
+            throw std::runtime_error{"Failed to listen on " + m_socket_path.string()};
+        }
+        while (!m_stopping) {
+            const int client_fd = accept(server_fd, nullptr, nullptr);
+            if (client_fd < 0) continue;
+            {
+                std::lock_guard lock{m_connections_mutex};
+                ++m_connections;
+            }
+            std::thread{[this, client_fd, server_fd] {
+                serve_connection(client_fd, server_fd);
+                std::lock_guard lock{m_connections_mutex};
+                --m_connections;
+                m_connections_done.notify_all();
+            }}.detach();
+        }
+        {
+            std::unique_lock lock{m_connections_mutex};
+            m_connections_done.wait(lock, [this] { return m_connections == 0; });
+        }
+        close(server_fd);
+        std::filesystem::remove(m_socket_path);
+    }
+
+    void CompileServer::serve_connection(int client_fd, int server_fd) {
+        const auto request = read_line(client_fd);
+        Response response{false, "Malformed request."};
+        if (request) {
+            const auto separator = request->find(' ');
+            const auto type = parse_request_type(request->substr(0, separator));
+            if (type == request_shutdown) {
+                response = {true, "Shutting down."};
+                // wakes up the accept loop
+                m_stopping = true;
+                shutdown(server_fd, SHUT_RDWR);
+            } else if (type && separator != std::string::npos) {
+                try {
+                    response = handle(*type, request->substr(separator + 1));
+                } catch (const std::exception& ex) {
+                    response = {false, ex.what()};
+                }
+            }
+        }
+        write_all(client_fd, (response.ok ? "ok\n" : "error\n") + response.message);
+        close(client_fd);
+    }
+
+    std::optional<Response> send_request(const std::filesystem::path& socket_path, RequestType type, const std::filesystem::path& path) {
+        const auto address = make_address(socket_path);
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return std::nullopt;
+        if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+            close(fd);
+            return std::nullopt;
+        }
+        const auto absolute_path = path.empty() ? path : std::filesystem::absolute(path);
+        write_all(fd, std::string{request_names[type]} + ' ' + absolute_path.string() + '\n');
+        shutdown(fd, SHUT_WR);
+        const auto reply = read_all(fd);
+        close(fd);
+        const auto separator = reply.find('\n');
+        if (separator == std::string::npos) return std::nullopt;
+        return Response{reply.substr(0, separator) == "ok", reply.substr(separator + 1)};
+    }
+
+#else
+
+    void CompileServer::serve() {
+        throw std::runtime_error{"The compile server requires unix domain sockets."};
+    }
+
+    std::optional<Response> send_request(const std::filesystem::path&, RequestType, const std::filesystem::path&) {
+        return std::nullopt;
+    }
+
+#endif
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <optional>
+#include <unordered_map>
+
+#include "ast.h"
+#include "compiler.h"
+
+namespace sorth::server {
+
+    enum RequestType {
+        request_check,
+        request_compile,
+        request_shutdown,
+    };
+
+    struct Response {
+        bool ok;
+        std::string message;
+    };
+
+    std::filesystem::path default_socket_path();
+
+    // Keeps parsed and compiled programs in memory between requests, so a build calling the
+    // compiler for every file only pays for files that actually changed
+    class CompileServer {
+
+    public:
+
+        explicit CompileServer(std::filesystem::path socket_path) : m_socket_path(std::move(socket_path)) {}
+
+        // Accepts requests until a shutdown request arrives
+        void serve();
+
+        Response handle(RequestType type, const std::filesystem::path& path);
+
+    private:
+        struct Entry {
+            // guarded by m_mutex of the server
+            std::filesystem::file_time_type modified;
+            size_t hash{0};
+            // guarded by mutex, program is never changed after the entry is added
+            std::mutex mutex;
+            std::shared_ptr<const ast::Program> program;
+            std::optional<std::string> error;
+            std::optional<std::vector<compiler::Code>> code;
+        };
+
+        std::filesystem::path m_socket_path;
+        std::mutex m_mutex;
+        std::unordered_map<std::string, std::shared_ptr<Entry>> m_entries;
+
+        // every connection is served on its own thread, serve waits for them before returning
+        std::mutex m_connections_mutex;
+        std::condition_variable m_connections_done;
+        int64_t m_connections{0};
+        std::atomic<bool> m_stopping{false};
+
+        // parses outside of the lock, so requests for different files don't wait for each other
+        std::shared_ptr<Entry> lookup(const std::filesystem::path& path);
+
+        void compile(Entry& entry);
+
+        void serve_connection(int client_fd, int server_fd);
+    };
+
+    // Sends a request to a running server, returns nothing if none is listening
+    std::optional<Response> send_request(const std::filesystem::path& socket_path, RequestType type, const std::filesystem::path& path);
+
+    // Handles a request without a server
+    Response handle_locally(RequestType type, const std::filesystem::path& path);
+}
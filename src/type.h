@@ -4,7 +4,12 @@
 #pragma once
 
 #include <cstdint>
+#include <algorithm>
+#include <string>
+#include <sstream>
 #include <vector>
+#include <deque>
+#include <mutex>
 #include <unordered_map>
 
 namespace sorth::type {
@@ -19,41 +24,126 @@ namespace sorth::type {
         TypeStack out;
     };
 
-    constexpr int64_t basic_type_count = 3;
+    constexpr int64_t basic_type_count = 6;
     enum BasicType : type_t {
         invalid_t = -1,
         int_t = 1,
         bool_t = 2,
         char_t = 3,
+        // handle to a spawned task, see make_task_type
+        task_t = 4,
+        // (pointer, length) view of immutable bytes
+        str_t = 5,
+        // (pointer, length) view of int buffer allocated from the runtime arena
+        buf_t = 6,
     };
 
-    static type_t from_name(const std::string& name) {
-        static_assert(basic_type_count == 3);
+    // A task type remembers the outputs of the spawned function, so join can push the right types.
+    // The outputs are interned in a table shared by all parses, task types are task_t + (index << 8)
+    struct TaskTypes {
+        std::mutex mutex;
+        std::deque<TypeStack> outputs;
+    };
+
+    inline TaskTypes& task_types() {
+        static TaskTypes types;
+        return types;
+    }
+
+    inline type_t make_task_type(const TypeStack& outputs) {
+        auto& types = task_types();
+        std::lock_guard lock{types.mutex};
+        auto it = std::find(types.outputs.begin(), types.outputs.end(), outputs);
+        if (it == types.outputs.end()) it = types.outputs.insert(it, outputs);
+        return task_t + (static_cast<type_t>(it - types.outputs.begin()) << 8);
+    }
+
+    inline bool is_task_type(const type_t& type) {
+        return type > 0 && (type & 0xff) == task_t;
+    }
+
+    inline TypeStack get_task_outputs(const type_t& type) {
+        auto& types = task_types();
+        std::lock_guard lock{types.mutex};
+        return types.outputs.at(static_cast<size_t>(type >> 8));
+    }
+
+    inline type_t from_name(const std::string& name);
+
+    // task(<type>,<type>...)
+    inline type_t task_type_from_name(const std::string& name) {
+        if (!name.starts_with("task(") || !name.ends_with(')')) return invalid_t;
+        TypeStack outputs;
+        int64_t depth = 0;
+        size_t begin = 5;
+        for (size_t i = begin; i < name.size(); ++i) {
+            if (name[i] == '(') {
+                ++depth;
+            } else if ((name[i] == ',' && depth == 0) || (name[i] == ')' && depth-- == 0)) {
+                if (name[i] == ')' && i + 1 != name.size()) return invalid_t;
+                if (i == begin && name[i] == ')' && outputs.empty()) break;
+                const auto type = from_name(name.substr(begin, i - begin));
+                if (type == invalid_t) return invalid_t;
+                outputs.push_back(type);
+                begin = i + 1;
+            }
+        }
+        return make_task_type(outputs);
+    }
+
+    inline type_t from_name(const std::string& name) {
+        static_assert(basic_type_count == 6);
         static const std::unordered_map<std::string, BasicType> basic_types {
                 {"int", int_t},
                 {"bool", bool_t},
                 {"char", char_t},
+                {"str", str_t},
+                {"buf", buf_t},
         };
         if (basic_types.contains(name)) {
             return basic_types.at(name);
         }
-        return invalid_t;
+        return task_type_from_name(name);
     }
 
-    static std::string to_name(const type_t& type) {
-        static_assert(basic_type_count == 3);
+    inline std::string to_name(const type_t& type) {
+        static_assert(basic_type_count == 6);
         static const std::unordered_map<type_t , std::string> basic_types {
                 {int_t, "int"},
                 {bool_t, "bool"},
                 {char_t, "char"},
+                {str_t, "str"},
+                {buf_t, "buf"},
         };
         if (basic_types.contains(type)) {
             return basic_types.at(type);
         }
+        if (is_task_type(type)) {
+            std::string name = "task(";
+            for (const auto& output : get_task_outputs(type)) {
+                if (name.back() != '(') name += ',';
+                name += to_name(output);
+            }
+            return name + ')';
+        }
         return "invalid";
     }
 
-    static std::string output_stack(const TypeStack& stack) {
+    // number of data stack slots a value of the type occupies at runtime
+    inline int64_t get_slot_count(const type_t& type) {
+        static_assert(basic_type_count == 6);
+        return type == str_t || type == buf_t ? 2 : 1;
+    }
+
+    inline int64_t get_slot_count(const TypeStack& stack) {
+        int64_t count = 0;
+        for (const auto& type : stack) {
+            count += get_slot_count(type);
+        }
+        return count;
+    }
+
+    inline std::string output_stack(const TypeStack& stack) {
         std::stringstream os;
         for (const auto& type : stack) {
             os << to_name(type) << ' ';
@@ -61,7 +151,7 @@ namespace sorth::type {
         return os.str();
     }
 
-    static std::string output_signature(const TypeSignature& signature) {
+    inline std::string output_signature(const TypeSignature& signature) {
         std::stringstream os;
         os << output_stack(signature.in) << "-- " << output_stack(signature.out);
         return os.str();